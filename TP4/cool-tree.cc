@@ -446,7 +446,7 @@ Classes single_Classes(Class_ e)
 
 Classes append_Classes(Classes p1, Classes p2)
 {
-   return new append_node<Class_>(p1, p2);
+   return array_node<Class_>::append(p1, p2);
 }
 
 Features nil_Features()
@@ -461,7 +461,7 @@ Features single_Features(Feature e)
 
 Features append_Features(Features p1, Features p2)
 {
-   return new append_node<Feature>(p1, p2);
+   return array_node<Feature>::append(p1, p2);
 }
 
 Formals nil_Formals()
@@ -476,7 +476,7 @@ Formals single_Formals(Formal e)
 
 Formals append_Formals(Formals p1, Formals p2)
 {
-   return new append_node<Formal>(p1, p2);
+   return array_node<Formal>::append(p1, p2);
 }
 
 Expressions nil_Expressions()
@@ -491,7 +491,7 @@ Expressions single_Expressions(Expression e)
 
 Expressions append_Expressions(Expressions p1, Expressions p2)
 {
-   return new append_node<Expression>(p1, p2);
+   return array_node<Expression>::append(p1, p2);
 }
 
 Cases nil_Cases()
@@ -506,7 +506,7 @@ Cases single_Cases(Case e)
 
 Cases append_Cases(Cases p1, Cases p2)
 {
-   return new append_node<Case>(p1, p2);
+   return array_node<Case>::append(p1, p2);
 }
 
 Program program(Classes classes)
@@ -14,6 +14,63 @@
 #include "cool-tree.handcode.h"
 
 #include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <atomic>
+
+
+// Identifiers in scope, mapped to their declared type. Every identifier
+// gets a slot the first time it is bound, holding its innermost binding.
+// Each binding remembers the one it shadows, so leaving a scope just
+// undoes the bindings made since the matching enterscope
+class VariableTable {
+private:
+  struct Binding {
+    int slot;
+    Symbol type;
+    int shadowed;
+  };
+
+  std::unordered_map<Symbol, int> slots;
+  std::vector<int> innermost;
+  std::vector<Binding> bindings;
+  std::vector<int> scopeStarts;
+
+public:
+  void enterscope();
+  void exitscope();
+  void addid(Symbol, Symbol);
+  Symbol lookup(Symbol);
+  Symbol probe(Symbol);
+};
+
+
+// Classes and methods an expression refers to directly
+struct ExpressionUses {
+  // Names of dynamically dispatched methods
+  std::vector<Symbol> dispatched;
+  // Class and name of statically dispatched methods
+  std::vector< std::pair<Symbol, Symbol> > staticallyDispatched;
+  // Classes created with new
+  std::vector<Symbol> created;
+};
+
+
+// A semantic error: where it was found, what kind of error it is and the
+// message printed after the location
+struct Diagnostic {
+  std::string file;
+  int line;
+  std::string kind;
+  std::string message;
+  // Class being checked when the error was found, -1 before checking
+  int classIndex;
+};
 
 
 // We moved the ClassTable definition here, it was the only
@@ -25,18 +82,145 @@ private:
   ostream& error_stream;
   Classes classList;
 
+  // Errors found so far. They are only printed by flushErrors
+  std::vector<Diagnostic> diagnostics;
+  void report(Diagnostic&);
+  void emitDiagnostics(const std::vector<Diagnostic>&);
+
+  // Index of each class in classList, the class itself by index and
+  // the index of its parent (-1 for Object)
+  std::unordered_map<Symbol, int> classIndices;
+  std::vector<Class__class*> classNodes;
+  std::vector<int> parentIndices;
+
+  // Depth of each class in the inheritance tree (Object is 0) and the
+  // binary lifting table: ancestors[k][i] is the 2^k-th ancestor of i
+  std::vector<int> depth;
+  std::vector< std::vector<int> > ancestors;
+  std::map<std::pair<int, int>, int> joinCache;
+  bool parallel;
+
+  // Classes sorted so that every class comes after its parent
+  std::vector<int> topologicalOrder;
+
+  // For hierarchies of up to MAX_BITSET_CLASSES classes, the ancestors of
+  // each class as a bitset of bitsetWords words, one row per class
+  std::vector<unsigned long long> ancestorBits;
+  int bitsetWords;
+
+  void buildHierarchy();
+  void buildFeatureTables();
+  int joinIndex(int, int);
+
+  void parallelAnalysis(int);
+  void checkClasses(std::vector<Diagnostic>&, std::atomic<int>&);
+
+  // Fingerprint of the signature of each class by name: its parent,
+  // attributes and method signatures, and those of its ancestors.
+  // The set of class names gets a fingerprint of its own
+  std::map<std::string, std::string> fingerprints;
+  void buildFingerprints();
+
+  // Wall time of each phase, class and method in ms, printed with -s
+  double hierarchyTime, cycleTime, checkingTime;
+  std::vector<double> classTimes;
+  std::vector< std::vector< std::pair<Symbol, double> > > methodTimes;
+
+  // With -u, the features reachable from Main.main. The others only get
+  // their signatures checked
+  bool reachableOnly;
+  std::unordered_set<Feature_class*> reachableFeatures;
+  void findReachable();
+
+  // Files whose classes were checked elsewhere: the basic classes and the
+  // sources of the interface summaries loaded with -x
+  std::set<Symbol> precheckedFiles;
+  void loadInterfaces(Classes);
+  void loadInterface(const char*, const std::set<Symbol>&);
+
+  // Methods and attributes are kept with the class defining them. The
+  // classes are numbered in preorder, so the subclasses of a class are
+  // the range [preorder, preorderEnd). For each name, the index holds
+  // the outermost classes defining it, whose ranges don't overlap, in
+  // order, and a lookup is a binary search on those ranges
+  struct Definition {
+    int start;
+    int end;
+    Feature_class* feature;
+  };
+  typedef std::unordered_map<Symbol, std::vector<Definition> > FeatureIndex;
+
+  std::vector<int> preorder;
+  std::vector<int> preorderEnd;
+  FeatureIndex methodIndex;
+  FeatureIndex attributeIndex;
+  Feature_class* findFeature(FeatureIndex&, int, Symbol);
+
 public:
+  // The type ID of a class is its index in the class list. SELF_TYPE and
+  // names that are not classes get the negative IDs below
+  enum { NO_TYPE_ID = -1, SELF_TYPE_ID = -2, MAX_BITSET_CLASSES = 4096 };
+
   ClassTable(Classes);
   int errors() { return semant_errors; }
-  ostream& semant_error();
-  ostream& semant_error(Class_ c);
-  ostream& semant_error(Symbol filename, tree_node *t);
+
+  // Errors are reported as semant_error(file, line, kind) << message, and
+  // printed in the order classes were checked by flushErrors: as text or,
+  // with -m, as one JSON object per line
+  class ErrorReport;
+  ErrorReport semant_error(const std::string& filename, int line, const char* kind);
+  ErrorReport semant_error(Symbol filename, int line, const char* kind);
+  ErrorReport semant_error(Class_ c);
+  ErrorReport semant_error(Symbol filename, tree_node *t);
+  void flushErrors();
 
   void semanticAnalysis();
-  int inheritsFrom(std::string, std::string);
-  Class__class* lookup(std::string);
-  Class__class* nearestCommonParent(std::string, std::string);
-  Feature_class* findMethod(std::string, std::string);
+  int inheritsFrom(Symbol, Symbol);
+  int conforms(int, int);
+  int conforms(Expression_class*, Symbol);
+  int join(int, int);
+  int typeId(Symbol);
+  Symbol typeName(int);
+  Class__class* lookup(Symbol);
+  Class__class* nearestCommonParent(Symbol, Symbol);
+  Feature_class* findMethod(Symbol, Symbol);
+  Feature_class* findMethod(int, Symbol);
+  Feature_class* findAttribute(int, Symbol);
+
+  // Incremental checking: the results of each method of a class are
+  // cached together with the signatures they depended on
+  struct MethodCache;
+  MethodCache* openCache(Class__class*);
+  void checkMethod(MethodCache*, Feature_class*, VariableTable&, Class__class*);
+  void closeCache(MethodCache*);
+
+  void recordMethodTime(Class__class*, Symbol, double);
+
+  // Writes the interface summary of every file checked here (-e)
+  void writeInterfaces();
+
+  int isReachable(Feature_class* f) { return !reachableOnly || reachableFeatures.count(f); }
+  void printStatistics(ostream&);
+};
+
+// The message of an error being reported. The error is handed to the
+// class table when the statement reporting it ends
+class ClassTable::ErrorReport {
+private:
+  ClassTable* table;
+  Diagnostic diagnostic;
+  std::ostringstream message;
+
+public:
+  ErrorReport(ClassTable*, const std::string&, int, const char*);
+  ErrorReport(ErrorReport&&);
+  ~ErrorReport();
+
+  template <class T>
+  ErrorReport& operator<<(const T& value) {
+    message << value;
+    return *this;
+  }
 };
 
 template <class SYM, class DAT>
@@ -80,7 +264,7 @@ public:
    virtual Symbol get_parent() { return (new Entry("", 0, 0)); }
    virtual Features get_features() { return nil_Features(); }
 
-   virtual void semant(ClassTable& classes) { return; }
+   virtual void semant(ClassTable& classes, VariableTable& variables) { return; }
 };
 
 
@@ -104,7 +288,7 @@ public:
    virtual Expression get_expr() { return no_expr(); }
    virtual Cases get_cases() { return nil_Cases(); }
 
-   virtual void semant(ClassTable& classes, SymbolTable<std::string, char*>& variables,
+   virtual void semant(ClassTable& classes, VariableTable& variables,
                        Class__class* currentClass) { return; }
 };
 
@@ -149,7 +333,7 @@ public:
    virtual Symbol get_type_decl() { return (new Entry("", 0, 0)); }
    virtual Expression get_init() { return this; }
 
-   virtual int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   virtual int semant(ClassTable&, VariableTable&,
                Class__class*) { return 1; }
 };
 
@@ -171,7 +355,7 @@ public:
    virtual Expression get_expr() { return no_expr(); }
 
 
-   virtual void semant(ClassTable& classes, SymbolTable<std::string, char*>& variables,
+   virtual void semant(ClassTable& classes, VariableTable& variables,
                Class__class* currentClass) { return; }
 };
 
@@ -252,7 +436,7 @@ public:
    Symbol get_parent() { return parent; }
    Features get_features() { return features; }
 
-   void semant(ClassTable&);
+   void semant(ClassTable&, VariableTable&);
 };
 
 
@@ -287,7 +471,7 @@ public:
    Symbol get_ftype() { return return_type; }
    Expression get_expr() { return expr; }
 
-   void semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void semant(ClassTable&, VariableTable&,
                        Class__class*);
 };
 
@@ -321,7 +505,7 @@ public:
    Symbol get_ftype() { return type_decl; }
    Expression get_expr() { return init; }
 
-   void semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void semant(ClassTable&, VariableTable&,
                        Class__class*);
 };
 
@@ -377,7 +561,7 @@ public:
    Symbol get_type_decl() { return type_decl; }
    Expression get_expr() { return expr; }
 
-   void semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -406,7 +590,7 @@ public:
    Symbol get_name() { return name; }
    Expression get_expr() { return expr; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -436,7 +620,8 @@ public:
 #endif
 
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void collect_uses(ExpressionUses&);
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -464,7 +649,8 @@ public:
 #endif
 
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void collect_uses(ExpressionUses&);
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -496,7 +682,7 @@ public:
    Expression get_then_exp() { return then_exp; }
    Expression get_else_exp() { return else_exp; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -525,7 +711,7 @@ public:
    Expression get_pred() { return pred; }
    Expression get_body() { return body; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -554,7 +740,7 @@ public:
    Expression get_expr() { return expr; }
    Cases get_cases() { return cases; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -579,7 +765,7 @@ public:
 
    Expressions get_sbody() { return body; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -614,7 +800,7 @@ public:
    Expression get_init() { return init; }
    Expression get_body() { return body; }
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -639,7 +825,7 @@ public:
    plus_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -664,7 +850,7 @@ public:
    sub_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -689,7 +875,7 @@ public:
    mul_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -714,7 +900,7 @@ public:
    divide_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -737,7 +923,7 @@ public:
    neg_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -762,7 +948,7 @@ public:
    lt_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -787,7 +973,7 @@ public:
    eq_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -812,7 +998,7 @@ public:
    leq_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -835,7 +1021,7 @@ public:
    comp_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -858,7 +1044,7 @@ public:
    int_const_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -881,7 +1067,7 @@ public:
    bool_const_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -904,7 +1090,7 @@ public:
    string_const_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -927,7 +1113,8 @@ public:
    new__EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   void collect_uses(ExpressionUses&);
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -950,7 +1137,7 @@ public:
    isvoid_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -971,7 +1158,7 @@ public:
    no_expr_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
@@ -994,7 +1181,7 @@ public:
    object_EXTRAS
 #endif
 
-   int semant(ClassTable&, SymbolTable<std::string, char*>&,
+   int semant(ClassTable&, VariableTable&,
                Class__class*);
 };
 
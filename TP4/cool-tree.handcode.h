@@ -8,6 +8,7 @@
 #include "tree.h"
 #include "cool.h"
 #include "stringtab.h"
+#include <vector>
 #define yylineno curr_lineno;
 extern int yylineno;
 
@@ -44,6 +45,65 @@ typedef Expressions_class *Expressions;
 typedef list_node<Case> Cases_class;
 typedef Cases_class *Cases;
 
+//
+// array_node keeps the elements of a list in one array, so that nth
+// and len take constant time instead of walking the chain of
+// append_nodes.  The append_ constructors build these: appending to
+// the longest list on an array grows the array in place, and the
+// shorter lists sharing it go on seeing their own prefix only.
+//
+template <class Elem>
+class array_node : public list_node<Elem> {
+private:
+    std::vector<Elem> *elems;
+    int length;
+public:
+    array_node(std::vector<Elem> *e, int n) { elems = e; length = n; }
+    list_node<Elem> *copy_list();
+    int len() { return length; }
+    Elem nth_length(int n, int &len)
+        { len = length; return n >= 0 && n < length ? (*elems)[n] : NULL; }
+    void dump(ostream& stream, int n);
+    static list_node<Elem> *append(list_node<Elem> *l1, list_node<Elem> *l2);
+};
+
+template <class Elem>
+list_node<Elem> *array_node<Elem>::copy_list()
+{
+    std::vector<Elem> *copy = new std::vector<Elem>();
+    copy->reserve(length);
+    for (int i = 0; i < length; i++)
+        copy->push_back((Elem) (*elems)[i]->copy());
+    return new array_node<Elem>(copy, length);
+}
+
+template <class Elem>
+void array_node<Elem>::dump(ostream& stream, int n)
+{
+    for (int i = 0; i < length; i++)
+        (*elems)[i]->dump(stream, n);
+}
+
+template <class Elem>
+list_node<Elem> *array_node<Elem>::append(list_node<Elem> *l1, list_node<Elem> *l2)
+{
+    array_node<Elem> *a = dynamic_cast<array_node<Elem> *>(l1);
+    std::vector<Elem> *e;
+    if (a != NULL && a->length == (int) a->elems->size())
+        e = a->elems;
+    else {
+        int n = l1->len();
+        e = new std::vector<Elem>();
+        e->reserve(n + l2->len());
+        for (int i = 0; i < n; i++)
+            e->push_back(l1->nth(i));
+    }
+    int n = l2->len();
+    for (int i = 0; i < n; i++)
+        e->push_back(l2->nth(i));
+    return new array_node<Elem>(e, e->size());
+}
+
 #define Program_EXTRAS                          \
 virtual void semant() = 0;			\
 virtual void dump_with_types(ostream&, int) = 0; 
@@ -93,13 +153,19 @@ void dump_with_types(ostream& ,int);
 
 #define Expression_EXTRAS                    \
 Symbol type;                                 \
+int type_id;                                 \
 Symbol get_type() { return type; }           \
-Expression set_type(Symbol s) { type = s; return this; } \
+int get_type_id() { return type_id; }        \
+Expression set_type(Symbol s) { type = s; type_id = -1; return this; } \
+Expression set_type(Symbol s, int id) { type = s; type_id = id; return this; } \
 virtual void dump_with_types(ostream&,int) = 0;  \
 void dump_type(ostream&, int);               \
-Expression_class() { type = (Symbol) NULL; }
+virtual void collect_expressions(std::vector<Expression_class*>&) = 0; \
+virtual void collect_uses(ExpressionUses&) { }  \
+Expression_class() { type = (Symbol) NULL; type_id = -1; }
 
 #define Expression_SHARED_EXTRAS           \
-void dump_with_types(ostream&,int); 
+void dump_with_types(ostream&,int);        \
+void collect_expressions(std::vector<Expression_class*>&);
 
 #endif
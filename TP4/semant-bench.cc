@@ -0,0 +1,440 @@
+//////////////////////////////////////////////////////////////////////
+//
+// semant-bench
+//
+// Generates Cool programs with pathological shapes and times the
+// semantic checker on them:
+//
+//    deep       a single inheritance chain
+//    layered    a chain where every class adds an attribute and a method
+//    wide       many classes inheriting directly from Object
+//    bigmethod  one method with a huge body
+//    dispatch   bodies made of method calls on many classes
+//    joins      many if and case expressions whose branches must be joined
+//
+// For each program we time the ClassTable construction, semanticAnalysis
+// and the individual ClassTable queries, and measure the heap the checker
+// still holds after the analysis. Without arguments every generator is
+// run at increasing sizes and the growth of each time and of the heap is
+// printed as an exponent (1 is linear, 2 quadratic), so complexity
+// regressions show up as a jump in those numbers.
+//
+//    semant-bench [-j jobs] [-o file] [generator [size]]
+//
+// With -o the generated program is written to file in the format produced
+// by the parser, so it can be fed to semant on its own.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "cool-tree.h"
+
+FILE *ast_file = stdin;       // needed to link with the AST parser
+int cool_yydebug;             // not used, but needed to link with handle_flags
+char *curr_filename;
+
+int curr_lineno;    // Needed for lexical analyser
+
+extern int optind;
+extern char *out_filename;
+extern int node_lineno;
+
+void handle_flags(int argc, char *argv[]);
+
+static Symbol filename;
+
+static Symbol id(const std::string& name) {
+    return idtable.add_string((char*) name.c_str());
+}
+
+static Symbol number(int n) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", n);
+    return inttable.add_string(buffer);
+}
+
+static std::string indexed(const char* prefix, int i) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%s%d", prefix, i);
+    return buffer;
+}
+
+// Lists are built one element at a time, the same way the parser does
+static Classes addClass(Classes classes, Class_ c) {
+    return append_Classes(classes, single_Classes(c));
+}
+
+static Features addFeature(Features features, Feature f) {
+    return append_Features(features, single_Features(f));
+}
+
+static Expressions addExpression(Expressions expressions, Expression e) {
+    return append_Expressions(expressions, single_Expressions(e));
+}
+
+// class Main { main() : Object { body }; };
+static Class_ mainClass(Expression body) {
+    node_lineno++;
+    return class_(id("Main"), id("Object"),
+                  single_Features(method(id("main"), nil_Formals(), id("Object"), body)),
+                  filename);
+}
+
+// Every class overrides depth() and every hundredth one adds an
+// attribute, so the inherited tables stay small and the cost measured
+// is that of the chain itself
+static Classes deepHierarchy(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    Classes classes = nil_Classes();
+    Symbol parent = id("Object");
+
+    for(int i = 0; i < n; i++) {
+        Symbol name = id(indexed("Deep", i));
+        Features features = single_Features(method(id("depth"), nil_Formals(), id("Int"),
+                                                   int_const(number(i))));
+        if(i % 100 == 0) {
+            features = addFeature(features, attr(id(indexed("field", i)), parent, no_expr()));
+        }
+
+        node_lineno++;
+        classes = addClass(classes, class_(name, parent, features, filename));
+        names.push_back(name);
+        parent = name;
+    }
+    methods.push_back(id("depth"));
+
+    Expression body = dispatch(new_(parent), id("depth"), nil_Expressions());
+    return addClass(classes, mainClass(body));
+}
+
+// Every class adds an attribute and a method reading the attribute and
+// calling the method of its parent, so each class sees all the features
+// of its ancestors. Tables copied down the chain would grow with its
+// length, which shows up in the heap column
+static Classes layeredHierarchy(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    Classes classes = nil_Classes();
+    Symbol parent = id("Object");
+    Expression below = int_const(number(0));
+
+    for(int i = 0; i < n; i++) {
+        Symbol name = id(indexed("Layer", i));
+        Symbol field = id(indexed("field", i));
+        Symbol level = id(indexed("level", i));
+        Features features = single_Features(attr(field, id("Int"), no_expr()));
+        features = addFeature(features, method(level, nil_Formals(), id("Int"),
+                                               plus(below, object(field))));
+
+        node_lineno++;
+        classes = addClass(classes, class_(name, parent, features, filename));
+        names.push_back(name);
+        methods.push_back(level);
+        parent = name;
+        below = dispatch(object(id("self")), level, nil_Expressions());
+    }
+
+    Expression body = dispatch(new_(parent), methods.back(), nil_Expressions());
+    return addClass(classes, mainClass(body));
+}
+
+static Classes wideHierarchy(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    Classes classes = nil_Classes();
+
+    for(int i = 0; i < n; i++) {
+        Symbol name = id(indexed("Wide", i));
+        Features features = single_Features(method(id("value"), nil_Formals(), id("Int"),
+                                                   int_const(number(i))));
+        node_lineno++;
+        classes = addClass(classes, class_(name, id("Object"), features, filename));
+        names.push_back(name);
+    }
+    methods.push_back(id("value"));
+
+    return addClass(classes, mainClass(new_(names[0])));
+}
+
+// A single method whose body is a block of n statements, each one
+// declaring a local and updating an accumulator with it
+static Classes bigMethod(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    Symbol sum = id("sum");
+    Expressions statements = nil_Expressions();
+
+    for(int i = 0; i < n; i++) {
+        Symbol local = id(indexed("x", i));
+        node_lineno++;
+        statements = addExpression(statements,
+            let(local, id("Int"), int_const(number(i)),
+                assign(sum, plus(object(sum), mul(object(local), int_const(number(2)))))));
+    }
+
+    Features features = single_Features(attr(sum, id("Int"), no_expr()));
+    features = addFeature(features, method(id("run"), nil_Formals(), id("Int"), block(statements)));
+
+    Classes classes = single_Classes(class_(id("Big"), id("Object"), features, filename));
+    names.push_back(id("Big"));
+    methods.push_back(id("run"));
+
+    return addClass(classes, mainClass(dispatch(new_(id("Big")), id("run"), nil_Expressions())));
+}
+
+// A short hierarchy of classes, each calling methods of the previous one
+// and of itself through self and static dispatch
+static Classes dispatchHeavy(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    int classCount = (int) sqrt((double) n) + 1;
+    int callsPerClass = n / classCount + 1;
+
+    Classes classes = nil_Classes();
+    Symbol parent = id("Object");
+    Symbol step = id("step");
+    Symbol arg = id("n");
+
+    for(int i = 0; i < classCount; i++) {
+        Symbol name = id(indexed("Node", i));
+        Expressions calls = nil_Expressions();
+
+        for(int j = 0; j < callsPerClass; j++) {
+            Expression receiver = j % 2 == 0 ? object(id("self")) : new_(name);
+            Expression call = dispatch(receiver, step, single_Expressions(int_const(number(j))));
+            if(i > 0 && j % 3 == 0) {
+                call = static_dispatch(object(id("self")), parent, step,
+                                       single_Expressions(call));
+            }
+            calls = addExpression(calls, call);
+        }
+
+        Features features = single_Features(method(step, single_Formals(formal(arg, id("Int"))),
+                                                   id("Int"), object(arg)));
+        features = addFeature(features, method(id(indexed("calls", i)), nil_Formals(),
+                                               id("Int"), block(calls)));
+
+        node_lineno++;
+        classes = addClass(classes, class_(name, parent, features, filename));
+        names.push_back(name);
+        methods.push_back(id(indexed("calls", i)));
+        parent = name;
+    }
+    methods.push_back(step);
+
+    return addClass(classes, mainClass(new_(parent)));
+}
+
+// A balanced binary hierarchy, and a method with n conditionals and case
+// expressions whose branches are classes far apart in it
+static Classes manyJoins(int n, std::vector<Symbol>& names, std::vector<Symbol>& methods) {
+    int classCount = (int) sqrt((double) n) + 2;
+
+    Classes classes = nil_Classes();
+    for(int i = 0; i < classCount; i++) {
+        Symbol name = id(indexed("Tree", i));
+        Symbol parent = i == 0 ? id("Object") : names[(i - 1) / 2];
+        node_lineno++;
+        classes = addClass(classes, class_(name, parent, nil_Features(), filename));
+        names.push_back(name);
+    }
+
+    Symbol flag = id("flag");
+    Symbol value = id("value");
+    Expressions statements = nil_Expressions();
+    for(int i = 0; i < n; i++) {
+        Symbol left = names[(i * 7919) % classCount];
+        Symbol right = names[(i * 104729 + 1) % classCount];
+        node_lineno++;
+
+        if(i % 2 == 0) {
+            statements = addExpression(statements,
+                cond(object(flag), new_(left), new_(right)));
+        } else {
+            Cases cases = single_Cases(branch(id("a"), left, new_(right)));
+            cases = append_Cases(cases, single_Cases(branch(id("b"), right, new_(left))));
+            cases = append_Cases(cases, single_Cases(branch(id("c"), id("Object"), object(value))));
+            statements = addExpression(statements, typcase(object(value), cases));
+        }
+    }
+
+    Features features = single_Features(attr(flag, id("Bool"), no_expr()));
+    features = addFeature(features, attr(value, id("Object"), no_expr()));
+    features = addFeature(features, method(id("join"), nil_Formals(), id("Object"),
+                                           block(statements)));
+    classes = addClass(classes, class_(id("Joins"), id("Object"), features, filename));
+    methods.push_back(id("join"));
+
+    return addClass(classes, mainClass(new_(id("Joins"))));
+}
+
+typedef Classes (*Generator)(int, std::vector<Symbol>&, std::vector<Symbol>&);
+
+struct Benchmark {
+    const char* name;
+    Generator generate;
+};
+
+static Benchmark benchmarks[] = {
+    { "deep", deepHierarchy },
+    { "layered", layeredHierarchy },
+    { "wide", wideHierarchy },
+    { "bigmethod", bigMethod },
+    { "dispatch", dispatchHeavy },
+    { "joins", manyJoins },
+};
+
+static const int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+static const int queries = 200000;
+
+struct Timings {
+    double table;       // ClassTable construction, in ms
+    double analysis;    // semanticAnalysis, in ms
+    double lookup;      // average time of each query, in ns
+    double inherits;
+    double join;
+    double method;
+    double heap;        // heap held after semanticAnalysis, in MB
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed(Clock::time_point start, double unit) {
+    return std::chrono::duration<double>(Clock::now() - start).count() / unit;
+}
+
+// Keeps the compiler from dropping the queries
+static volatile long sink;
+
+static Timings run(Benchmark& benchmark, int size) {
+    std::vector<Symbol> names, methods;
+    Classes classes = benchmark.generate(size, names, methods);
+
+    if(out_filename != NULL) {
+        std::ofstream out(out_filename);
+        program(classes)->dump_with_types(out, 0);
+    }
+
+    Timings t;
+    size_t heapBefore = mallinfo2().uordblks;
+    Clock::time_point start = Clock::now();
+    ClassTable* table = new ClassTable(classes);
+    t.table = elapsed(start, 1e-3);
+
+    if(table->errors()) {
+        cerr << benchmark.name << ": generated program has errors" << endl;
+        exit(1);
+    }
+
+    start = Clock::now();
+    table->semanticAnalysis();
+    t.analysis = elapsed(start, 1e-3);
+    t.heap = ((double) mallinfo2().uordblks - heapBefore) / (1 << 20);
+
+    // The queries pick their classes with a fixed sequence, so every run
+    // does the same work
+    unsigned int seed = 1;
+    long found = 0;
+    int n = names.size();
+
+    start = Clock::now();
+    for(int i = 0; i < queries; i++) {
+        seed = seed * 1103515245 + 12345;
+        found += table->lookup(names[seed % n]) != NULL;
+    }
+    t.lookup = elapsed(start, 1e-9) / queries;
+
+    start = Clock::now();
+    for(int i = 0; i < queries; i++) {
+        seed = seed * 1103515245 + 12345;
+        Symbol a = names[seed % n];
+        seed = seed * 1103515245 + 12345;
+        found += table->inheritsFrom(a, names[seed % n]);
+    }
+    t.inherits = elapsed(start, 1e-9) / queries;
+
+    start = Clock::now();
+    for(int i = 0; i < queries; i++) {
+        seed = seed * 1103515245 + 12345;
+        Symbol a = names[seed % n];
+        seed = seed * 1103515245 + 12345;
+        found += table->nearestCommonParent(a, names[seed % n]) != NULL;
+    }
+    t.join = elapsed(start, 1e-9) / queries;
+
+    start = Clock::now();
+    for(int i = 0; i < queries; i++) {
+        seed = seed * 1103515245 + 12345;
+        Symbol c = names[seed % n];
+        seed = seed * 1103515245 + 12345;
+        found += table->findMethod(c, methods[seed % methods.size()]) != NULL;
+    }
+    t.method = elapsed(start, 1e-9) / queries;
+
+    sink = found;
+    return t;
+}
+
+static void printHeader() {
+    printf("%-10s %7s %10s %10s %10s %10s %10s %10s %10s\n", "generator", "size",
+           "table ms", "check ms", "lookup ns", "conform ns", "join ns", "method ns", "heap MB");
+}
+
+static void printTimings(const char* name, int size, Timings& t) {
+    printf("%-10s %7d %10.2f %10.2f %10.1f %10.1f %10.1f %10.1f %10.2f\n", name, size,
+           t.table, t.analysis, t.lookup, t.inherits, t.join, t.method, t.heap);
+}
+
+// Exponent k such that the time grows like size^k between two runs
+static double growth(double before, double after, int beforeSize, int afterSize) {
+    if(before <= 0 || after <= 0) return 0;
+    return log(after / before) / log((double) afterSize / beforeSize);
+}
+
+int main(int argc, char *argv[]) {
+    handle_flags(argc, argv);
+    filename = stringtable.add_string("<benchmark>");
+
+    Benchmark* selected = NULL;
+    if(optind < argc) {
+        for(int i = 0; i < benchmarkCount; i++) {
+            if(strcmp(argv[optind], benchmarks[i].name) == 0) selected = &benchmarks[i];
+        }
+        if(selected == NULL) {
+            cerr << "unknown generator " << argv[optind] << endl;
+            exit(1);
+        }
+    }
+
+    // A single program
+    if(selected != NULL) {
+        int size = optind + 1 < argc ? atoi(argv[optind + 1]) : 10000;
+        Timings t = run(*selected, size);
+        printHeader();
+        printTimings(selected->name, size, t);
+        return 0;
+    }
+
+    // Scaling curves for every generator
+    const int sizes[] = { 1250, 2500, 5000, 10000 };
+    const int sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+
+    printHeader();
+    for(int b = 0; b < benchmarkCount; b++) {
+        std::vector<Timings> results;
+        for(int s = 0; s < sizeCount; s++) {
+            results.push_back(run(benchmarks[b], sizes[s]));
+            printTimings(benchmarks[b].name, sizes[s], results.back());
+        }
+
+        Timings& first = results.front();
+        Timings& last = results.back();
+        printf("%-10s %7s %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n\n", "", "growth",
+               growth(first.table, last.table, sizes[0], sizes[sizeCount - 1]),
+               growth(first.analysis, last.analysis, sizes[0], sizes[sizeCount - 1]),
+               growth(first.lookup, last.lookup, sizes[0], sizes[sizeCount - 1]),
+               growth(first.inherits, last.inherits, sizes[0], sizes[sizeCount - 1]),
+               growth(first.join, last.join, sizes[0], sizes[sizeCount - 1]),
+               growth(first.method, last.method, sizes[0], sizes[sizeCount - 1]),
+               growth(first.heap, last.heap, sizes[0], sizes[sizeCount - 1]));
+    }
+}
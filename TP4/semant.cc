@@ -9,13 +9,63 @@
 
 #include <vector>
 #include <map>
-#include <string>
 #include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <chrono>
 
 
 extern int semant_debug;
+extern int semant_jobs;
+extern char *semant_cache_dir;
+extern int semant_reachable;
+extern int semant_json_errors;
+extern char *semant_interface_dir;
+extern char **semant_interfaces;
+extern int semant_interface_count;
+extern int node_lineno;
 extern char *curr_filename;
 
+// Errors found by this thread while checking classes in parallel, or a
+// method for the cache, if any
+static thread_local std::vector<Diagnostic>* threadDiagnostics = NULL;
+
+// Index of the class this thread is checking, -1 while building the tables
+static thread_local int checkedClass = -1;
+
+// Classes looked at by the method being cached by this thread, if any.
+// -1 stands for a class that does not exist
+static thread_local std::set<int>* usedClasses = NULL;
+
+static void useClass(int index) {
+    if(usedClasses != NULL) usedClasses->insert(index);
+}
+
+// Number of times the checker did each of its basic operations, printed
+// with -s. Every thread counts on its own, and worker threads add their
+// counts to the totals when they finish
+struct OperationCounts {
+    long lookups;
+    long conformance;
+    long joins;
+    long scopes;
+    long variables;
+    long probes;
+};
+
+static thread_local OperationCounts counts;
+static OperationCounts workerCounts;
+static std::mutex workerCountsLock;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 // Symbols
@@ -57,6 +107,9 @@ static Symbol
 //
 static void initialize_constants(void)
 {
+    // The names never change, so they are only interned once per process
+    if(arg != NULL) return;
+
     arg         = idtable.add_string("arg");
     arg2        = idtable.add_string("arg2");
     Bool        = idtable.add_string("Bool");
@@ -88,421 +141,1660 @@ static void initialize_constants(void)
 
 }
 
-int findCycle(std::vector< std::vector<int> > graph, std::vector<int>& inCycle) {
-    // Since multiple inheritance is not allowed, we can just check if
-    // the whole inheritance graph is connected. If it is, it is valid.
-    // If it's not connected, it isn't valid.
-    std::vector<int> visited = std::vector<int>(graph.size(), 0);
-    std::vector<int> toVisit;
+int findCycle(const std::vector<int>& parent, std::vector<int>& inCycle) {
+    // Since multiple inheritance is not allowed, each class has a single
+    // parent and we can just check which classes reach Object by following
+    // their parents. The ones that don't are in a cycle or inherit from one.
+    enum { UNKNOWN, ON_PATH, REACHES_ROOT, CYCLIC };
+    std::vector<int> state = std::vector<int>(parent.size(), UNKNOWN);
+    std::vector<int> path;
     inCycle.clear();
 
-    toVisit.push_back(0);
+    for(unsigned int i = 0; i < parent.size(); i++) {
+        int current = i;
+        int result = REACHES_ROOT;
+
+        // Walk up until we find a class we already know about
+        while(current >= 0) {
+            if(state[current] == ON_PATH) {
+                result = CYCLIC;
+                break;
+            }
+            if(state[current] != UNKNOWN) {
+                result = state[current];
+                break;
+            }
+            state[current] = ON_PATH;
+            path.push_back(current);
+            current = parent[current];
+        }
+
+        // Every class in the path shares the same fate
+        for(unsigned int j = 0; j < path.size(); j++) state[path[j]] = result;
+        path.clear();
+    }
+
+    for(unsigned int i = 0; i < state.size(); i++) {
+        if(state[i] == CYCLIC) inCycle.push_back(i);
+    }
+
+    return inCycle.size();
+}
+
+// This creates the empty class list and checks the inheritance graph for errors
+ClassTable::ClassTable(Classes classes) : semant_errors(0) , error_stream(cerr), parallel(false),
+    hierarchyTime(0), cycleTime(0), checkingTime(0), reachableOnly(false) {
+
+    // The basic classes and the checks below need the predefined symbols
+    initialize_constants();
+
+    classList = nil_Classes();
+
+    // First we install the basic classes
+    install_basic_classes();
+
+    // Then the classes of the libraries given as interface summaries
+    loadInterfaces(classes);
+
+    // Now we add the user-defined classes
+    classList = append_Classes(classList, classes);
+
+    Clock::time_point start = Clock::now();
+
+    // Collect the classes in one pass, then map them
+    int classCount = classList->len();
+    classNodes.reserve(classCount);
+    for(int i = 0; i < classCount; i++)
+        classNodes.push_back(classList->nth(i));
+
+    std::unordered_map<Symbol, int>& indices = classIndices;
+    for(int i = 0; i < classCount; i++) {
+        Class__class* current = classNodes[i];
+        Symbol thisName = current->get_name();
+        if(indices.count(thisName) > 0) {
+            semant_error(current->get_filename(), current->get_line_number(), "class-redefined")
+                           << "Class " << thisName << " was previously defined.";
+        } else {
+            indices[thisName] = i;
+        }
+    }
+
+    // Create the inheritance graph, storing the parent of each class
+    parentIndices = std::vector<int>(classNodes.size(), -1);
+    for(unsigned int i = 0; i < classNodes.size(); i++) {
+        Symbol thisName = classNodes[i]->get_name();
+        Symbol parentName = classNodes[i]->get_parent();
+        Symbol fileName = classNodes[i]->get_filename();
+        int linenumber = classNodes[i]->get_line_number();
+        if(parentName != No_class) {
+            // Inheritance from invalid class
+            if(!indices.count(parentName)) {
+                semant_error(fileName, linenumber, "undefined-parent") << "Class "
+                               << thisName << " inherits from an undefined class "
+                               << parentName << ".";
+            } else if(parentName == Int || parentName == Str || parentName == Bool) {
+                semant_error(fileName, linenumber, "basic-parent") << "Class "
+                               << thisName << " cannot inherit class "
+                               << parentName << ".";
+            } else {
+                parentIndices[indices[thisName]] = indices[parentName];
+            }
+        }
+    }
+
+    hierarchyTime = millisecondsSince(start);
+    start = Clock::now();
+
+    std::vector<int> cycleClasses;
+    if(!errors() && findCycle(parentIndices, cycleClasses)) {
+        for(int i = cycleClasses.size() - 1; i >= 0; i--) {
+            int index = cycleClasses[i];
+            Symbol thisName = classNodes[index]->get_name();
+            Symbol fileName = classNodes[index]->get_filename();
+            int linenumber = classNodes[index]->get_line_number();
+            semant_error(fileName, linenumber, "inheritance-cycle") << "Class "
+                           << thisName << ", or an ancestor of " << thisName
+                           << ", is involved in an inheritance cycle.";
+        }
+    }
+
+    cycleTime = millisecondsSince(start);
+    start = Clock::now();
+
+    // The hierarchy is a valid tree, we can now precompute the join tables
+    // and the methods and attributes available in each class
+    if(!errors()) {
+        buildHierarchy();
+        buildFeatureTables();
+        if(semant_cache_dir != NULL) buildFingerprints();
+    }
+
+    hierarchyTime += millisecondsSince(start);
+}
+
+// Computes the depth of every class and the binary lifting table used to
+// find the least upper bound of two classes in logarithmic time
+void ClassTable::buildHierarchy() {
+    int n = classNodes.size();
+    std::vector<int> parent(parentIndices);
+    depth = std::vector<int>(n, -1);
+
+    for(int i = 0; i < n; i++) {
+        if(parent[i] < 0) {
+            // Object is the root, and its own ancestor
+            parent[i] = i;
+            depth[i] = 0;
+        }
+    }
+
+    // Classes may appear before their parents in the list, so we walk up
+    // until we reach a class whose depth is known
+    std::vector<int> path;
+    for(int i = 0; i < n; i++) {
+        int current = i;
+        while(depth[current] < 0) {
+            path.push_back(current);
+            current = parent[current];
+        }
+        while(!path.empty()) {
+            depth[path.back()] = depth[current] + 1;
+            current = path.back();
+            path.pop_back();
+        }
+    }
+
+    // Sorting the classes by depth puts every parent before its children
+    std::vector<int> perDepth(n + 1, 0);
+    for(int i = 0; i < n; i++) perDepth[depth[i] + 1]++;
+    for(int d = 1; d <= n; d++) perDepth[d] += perDepth[d - 1];
+    topologicalOrder = std::vector<int>(n);
+    for(int i = 0; i < n; i++) topologicalOrder[perDepth[depth[i]]++] = i;
+
+    int levels = 1;
+    while((1 << levels) < n) levels++;
+
+    ancestors.clear();
+    ancestors.push_back(parent);
+    for(int k = 1; k < levels; k++) {
+        std::vector<int>& previous = ancestors[k - 1];
+        std::vector<int> next(n);
+        for(int i = 0; i < n; i++) next[i] = previous[previous[i]];
+        ancestors.push_back(next);
+    }
+
+    // Small hierarchies also get a bitset of ancestors per class, built
+    // from the parent's row, so conformance is a single bit test
+    ancestorBits.clear();
+    bitsetWords = (n + 63) / 64;
+    if(n <= MAX_BITSET_CLASSES) {
+        ancestorBits = std::vector<unsigned long long>(n * bitsetWords, 0);
+        for(int t = 0; t < n; t++) {
+            int i = topologicalOrder[t];
+            if(parentIndices[i] >= 0) {
+                std::copy(ancestorBits.begin() + parentIndices[i] * bitsetWords,
+                          ancestorBits.begin() + (parentIndices[i] + 1) * bitsetWords,
+                          ancestorBits.begin() + i * bitsetWords);
+            }
+            ancestorBits[i * bitsetWords + i / 64] |= 1ULL << (i % 64);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Basic classes
+//
+// The signatures of the basic classes are fixed, so they are kept in the
+// static tables below and their trees are built once per process, then
+// shared by every class table. There's no need for method bodies, these
+// are already built into the runtime system.
+//
+//////////////////////////////////////////////////////////////////////
+
+// Each class, and its parent
+static Symbol* const basicClasses[][2] = {
+    { &Object, &No_class },
+    { &IO,     &Object   },
+    { &Int,    &Object   },
+    { &Bool,   &Object   },
+    { &Str,    &Object   },
+};
+
+// Each feature, in class order. Methods take up to two formals, called arg
+// and arg2, and attributes have no formal types
+struct BasicFeature {
+    Symbol* owner;
+    int isMethod;
+    Symbol* name;
+    Symbol* type;
+    Symbol* formalTypes[2];
+};
+
+static const BasicFeature basicFeatures[] = {
+    { &Object, 1, &cool_abort, &Object,    { NULL, NULL } },
+    { &Object, 1, &type_name,  &Str,       { NULL, NULL } },
+    { &Object, 1, &copy,       &SELF_TYPE, { NULL, NULL } },
+    { &IO,     1, &out_string, &SELF_TYPE, { &Str, NULL } },
+    { &IO,     1, &out_int,    &SELF_TYPE, { &Int, NULL } },
+    { &IO,     1, &in_string,  &Str,       { NULL, NULL } },
+    { &IO,     1, &in_int,     &Int,       { NULL, NULL } },
+    { &Int,    0, &val,        &prim_slot, { NULL, NULL } },
+    { &Bool,   0, &val,        &prim_slot, { NULL, NULL } },
+    { &Str,    0, &val,        &Int,       { NULL, NULL } },
+    { &Str,    0, &str_field,  &prim_slot, { NULL, NULL } },
+    { &Str,    1, &length,     &Int,       { NULL, NULL } },
+    { &Str,    1, &concat,     &Str,       { &Str, NULL } },
+    { &Str,    1, &substr,     &Str,       { &Int, &Int } },
+};
+
+static Classes basicClassList = NULL;
+static Symbol basicClassFile = NULL;
+
+static Classes buildBasicClasses() {
+    // The tree package uses this global to annotate the classes built below
+    node_lineno = 0;
+
+    Symbol* formalNames[] = { &arg, &arg2 };
+    unsigned int featureCount = sizeof(basicFeatures) / sizeof(basicFeatures[0]);
+    unsigned int classCount = sizeof(basicClasses) / sizeof(basicClasses[0]);
+
+    Classes classes = nil_Classes();
+    for(unsigned int i = 0; i < classCount; i++) {
+        Features features = nil_Features();
+
+        for(unsigned int j = 0; j < featureCount; j++) {
+            const BasicFeature& f = basicFeatures[j];
+            if(f.owner != basicClasses[i][0]) continue;
+
+            Feature feature;
+            if(f.isMethod) {
+                Formals formals = nil_Formals();
+                for(int k = 0; k < 2 && f.formalTypes[k] != NULL; k++) {
+                    formals = append_Formals(formals,
+                        single_Formals(formal(*formalNames[k], *f.formalTypes[k])));
+                }
+                feature = method(*f.name, formals, *f.type, no_expr());
+            } else {
+                feature = attr(*f.name, *f.type, no_expr());
+            }
+            features = append_Features(features, single_Features(feature));
+        }
+
+        classes = append_Classes(classes, single_Classes(
+            class_(*basicClasses[i][0], *basicClasses[i][1], features, basicClassFile)));
+    }
+
+    return classes;
+}
+
+void ClassTable::install_basic_classes() {
+    if(basicClassList == NULL) {
+        basicClassFile = stringtable.add_string("<basic class>");
+        basicClassList = buildBasicClasses();
+    }
+
+    classList = append_Classes(classList, basicClassList);
+    precheckedFiles.insert(basicClassFile);
+}
+
+////////////////////////////////////////////////////////////////////
+//
+// semant_error is an overloaded function for reporting errors
+// during semantic analysis.  There are four versions:
+//
+//    ClassTable::semant_error(const std::string& filename, int line, const char* kind)
+//    ClassTable::semant_error(Symbol filename, int line, const char* kind)
+//       report an error of the given kind at a line of a file
+//
+//    ClassTable::semant_error(Class_ c)
+//       report an error at the line and file of `c'
+//
+//    ClassTable::semant_error(Symbol filename, tree_node *t)  
+//       report an error at the line of `t'
+//
+// All of them return a report the message is written to with <<.
+// The errors are kept until flushErrors prints them.
+//
+///////////////////////////////////////////////////////////////////
+
+ClassTable::ErrorReport ClassTable::semant_error(const std::string& filename, int line,
+                                                 const char* kind)
+{
+    return ErrorReport(this, filename, line, kind);
+}
+
+ClassTable::ErrorReport ClassTable::semant_error(Symbol filename, int line, const char* kind)
+{
+    return ErrorReport(this, filename->get_string(), line, kind);
+}
+
+ClassTable::ErrorReport ClassTable::semant_error(Class_ c)
+{                                                             
+    return semant_error(c->get_filename(),c);
+}    
+
+ClassTable::ErrorReport ClassTable::semant_error(Symbol filename, tree_node *t)
+{
+    return semant_error(filename, t->get_line_number(), "error");
+}
+
+ClassTable::ErrorReport::ErrorReport(ClassTable* t, const std::string& file, int line,
+                                     const char* kind) : table(t) {
+    diagnostic.file = file;
+    diagnostic.line = line;
+    diagnostic.kind = kind;
+    diagnostic.classIndex = -1;
+}
+
+// Only the last copy of a report hands the error over
+ClassTable::ErrorReport::ErrorReport(ErrorReport&& other)
+    : table(other.table), diagnostic(other.diagnostic) {
+    message << other.message.str();
+    other.table = NULL;
+}
+
+ClassTable::ErrorReport::~ErrorReport() {
+    if(table == NULL) return;
+
+    diagnostic.message = message.str();
+    table->report(diagnostic);
+}
+
+// Keeps an error until the errors are flushed. Errors found while checking
+// classes in parallel, or a method for the cache, go to the thread's own list
+void ClassTable::report(Diagnostic& diagnostic) {
+    diagnostic.classIndex = checkedClass;
 
-    while(!toVisit.empty()) {
-        int current = toVisit.back();
-        toVisit.pop_back();
+    if(threadDiagnostics != NULL) {
+        threadDiagnostics->push_back(diagnostic);
+    } else {
+        diagnostics.push_back(diagnostic);
+        semant_errors++;
+    }
+}
+
+// Reports errors found earlier again, as errors of the class being checked
+void ClassTable::emitDiagnostics(const std::vector<Diagnostic>& found) {
+    for(unsigned int i = 0; i < found.size(); i++) {
+        Diagnostic diagnostic = found[i];
+        report(diagnostic);
+    }
+}
+
+static bool foundEarlier(const Diagnostic& a, const Diagnostic& b) {
+    return a.classIndex < b.classIndex;
+}
+
+// Quotes a string for JSON output
+static std::string jsonString(const std::string& text) {
+    std::ostringstream quoted;
+    quoted << '"';
+    for(unsigned int i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if(c == '"' || c == '\\') {
+            quoted << '\\' << c;
+        } else if(c == '\n') {
+            quoted << "\\n";
+        } else if(c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted << escaped;
+        } else {
+            quoted << c;
+        }
+    }
+    quoted << '"';
+    return quoted.str();
+}
+
+// Prints the errors found so far with a single write. They are sorted by the
+// class being checked when they were found, keeping the order they were found
+// in within a class, so the output doesn't depend on how classes were checked
+void ClassTable::flushErrors() {
+    std::stable_sort(diagnostics.begin(), diagnostics.end(), foundEarlier);
+
+    std::ostringstream text;
+    for(unsigned int i = 0; i < diagnostics.size(); i++) {
+        const Diagnostic& d = diagnostics[i];
+        if(semant_json_errors) {
+            text << "{\"file\": " << jsonString(d.file) << ", \"line\": " << d.line
+                 << ", \"kind\": " << jsonString(d.kind)
+                 << ", \"message\": " << jsonString(d.message) << "}\n";
+        } else {
+            text << d.file << ":" << d.line << ": " << d.message << "\n";
+        }
+    }
+
+    error_stream << text.str();
+    diagnostics.clear();
+}
+
+// Checks if the given class exists and returns it
+Class__class* ClassTable::lookup(Symbol className) {
+    counts.lookups++;
+    std::unordered_map<Symbol, int>::iterator found = classIndices.find(className);
+
+    if(found == classIndices.end()) {
+        useClass(-1);
+        return NULL;
+    }
+
+    useClass(found->second);
+    return classNodes[found->second];
+}
+
+// Type ID of a class name, see ClassTable
+int ClassTable::typeId(Symbol type) {
+    if(type == SELF_TYPE) return SELF_TYPE_ID;
+
+    std::unordered_map<Symbol, int>::iterator found = classIndices.find(type);
+    if(found == classIndices.end()) return NO_TYPE_ID;
+
+    return found->second;
+}
+
+// Name of the class with the given type ID
+Symbol ClassTable::typeName(int id) {
+    return classNodes[id]->get_name();
+}
+
+// Checks if a given class inherits from another (directly or indirectly)
+int ClassTable::inheritsFrom(Symbol child, Symbol parent) {
+    if(child == parent) return 1;
+
+    return conforms(typeId(child), typeId(parent));
+}
+
+// Checks if the type of an expression conforms to the given type
+int ClassTable::conforms(Expression_class* e, Symbol parent) {
+    if(e->get_type() == parent) return 1;
+
+    return conforms(e->get_type_id(), typeId(parent));
+}
+
+// Same as inheritsFrom, with type IDs
+int ClassTable::conforms(int child, int parent) {
+    counts.conformance++;
+
+    if(child < 0 || parent < 0) {
+        useClass(-1);
+        return 0;
+    }
+
+    useClass(child);
+    useClass(parent);
+
+    if(!ancestorBits.empty()) {
+        return (ancestorBits[child * bitsetWords + parent / 64] >> (parent % 64)) & 1;
+    }
+
+    // The parent must be the ancestor of child found at its depth
+    int current = child;
+    int diff = depth[current] - depth[parent];
+    if(diff < 0) return 0;
+
+    for(int k = 0; diff > 0; k++, diff >>= 1) {
+        if(diff & 1) current = ancestors[k][current];
+    }
+
+    return current == parent;
+}
+
+// Numbers the classes in preorder and builds the method and attribute
+// indices. An inherited name keeps its original definition, which is the
+// one every redefinition must match, so a class defining a name it
+// inherits isn't indexed for it. Repeated names inside a class keep the
+// first one.
+void ClassTable::buildFeatureTables() {
+    int n = classNodes.size();
+
+    std::vector< std::vector<int> > children(n);
+    for(int i = 0; i < n; i++) {
+        if(parentIndices[i] >= 0) children[parentIndices[i]].push_back(i);
+    }
+
+    // The walk keeps its own stack, a long chain of classes would
+    // overflow the call stack
+    preorder = std::vector<int>(n);
+    preorderEnd = std::vector<int>(n);
+    std::vector<int> order;
+    std::vector< std::pair<int, unsigned int> > stack;
+    for(int i = 0; i < n; i++) {
+        if(parentIndices[i] >= 0) continue;
+
+        preorder[i] = order.size();
+        order.push_back(i);
+        stack.push_back(std::make_pair(i, 0));
+        while(!stack.empty()) {
+            int current = stack.back().first;
+            if(stack.back().second < children[current].size()) {
+                int child = children[current][stack.back().second++];
+                preorder[child] = order.size();
+                order.push_back(child);
+                stack.push_back(std::make_pair(child, 0));
+            } else {
+                preorderEnd[current] = order.size();
+                stack.pop_back();
+            }
+        }
+    }
+
+    methodIndex.clear();
+    attributeIndex.clear();
+    for(int t = 0; t < n; t++) {
+        int i = order[t];
+        Features f = classNodes[i]->get_features();
+        for(int j = f->first(); f->more(j); j = f->next(j)) {
+            Feature_class* feature = f->nth(j);
+            FeatureIndex& index = feature->isMethod() ? methodIndex : attributeIndex;
+            std::vector<Definition>& definitions = index[feature->get_name()];
+
+            // Classes come in preorder, so only the last definition can
+            // enclose this class
+            if(!definitions.empty() && definitions.back().end > t) continue;
+
+            Definition definition = { t, preorderEnd[i], feature };
+            definitions.push_back(definition);
+        }
+    }
+}
+
+// The definition of a name visible in the class with index c, if any
+Feature_class* ClassTable::findFeature(FeatureIndex& index, int c, Symbol name) {
+    FeatureIndex::iterator found = index.find(name);
+    if(found == index.end()) return NULL;
+
+    // Last definition starting at or before the class
+    std::vector<Definition>& definitions = found->second;
+    int position = preorder[c];
+    int low = 0, high = definitions.size();
+    while(low < high) {
+        int middle = (low + high) / 2;
+        if(definitions[middle].start <= position) low = middle + 1;
+        else high = middle;
+    }
+
+    if(low == 0 || definitions[low - 1].end <= position) return NULL;
+    return definitions[low - 1].feature;
+}
+
+// Lowest common ancestor of the classes with indices a and b
+int ClassTable::joinIndex(int a, int b) {
+    if(depth[a] < depth[b]) std::swap(a, b);
+
+    // First we bring a up to the same depth as b
+    int diff = depth[a] - depth[b];
+    for(int k = 0; diff > 0; k++, diff >>= 1) {
+        if(diff & 1) a = ancestors[k][a];
+    }
+    if(a == b) return a;
+
+    // Then we lift both while their ancestors differ
+    for(int k = ancestors.size() - 1; k >= 0; k--) {
+        if(ancestors[k][a] != ancestors[k][b]) {
+            a = ancestors[k][a];
+            b = ancestors[k][b];
+        }
+    }
+
+    return ancestors[0][a];
+}
+
+// Finds the most specific class which is a parent to both class c1 and c2
+Class__class* ClassTable::nearestCommonParent(Symbol c1, Symbol c2) {
+    return classNodes[join(typeId(c1), typeId(c2))];
+}
+
+// Same as nearestCommonParent, with type IDs. Anything that is not a
+// class joins to Object
+int ClassTable::join(int first, int second) {
+    counts.joins++;
+
+    if(first < 0 || second < 0) {
+        useClass(-1);
+        return typeId(Object);
+    }
+
+    useClass(first);
+    useClass(second);
+
+    int a = std::min(first, second);
+    int b = std::max(first, second);
+    std::pair<int, int> key = std::make_pair(a, b);
+
+    // The cache is shared, so parallel checks compute their joins directly
+    if(parallel) return joinIndex(a, b);
+
+    std::map<std::pair<int, int>, int>::iterator cached = joinCache.find(key);
+    if(cached != joinCache.end()) return cached->second;
+
+    // We only keep a small number of joins around
+    if(joinCache.size() >= 1024) joinCache.clear();
+
+    int result = joinIndex(a, b);
+    joinCache[key] = result;
+
+    return result;
+}
+
+// Finds a method belonging to c or one of it's ancestors
+Feature_class* ClassTable::findMethod(Symbol c, Symbol m) {
+    return findMethod(typeId(c), m);
+}
+
+Feature_class* ClassTable::findMethod(int c, Symbol m) {
+    counts.lookups++;
+
+    if(c < 0) {
+        useClass(-1);
+        return NULL;
+    }
+
+    useClass(c);
+    return findFeature(methodIndex, c, m);
+}
+
+// Finds an attribute c defines or inherits
+Feature_class* ClassTable::findAttribute(int c, Symbol a) {
+    counts.lookups++;
+
+    if(c < 0) {
+        useClass(-1);
+        return NULL;
+    }
+
+    useClass(c);
+    return findFeature(attributeIndex, c, a);
+}
+
+
+// Opens a new scope; bindings made from now on are undone by exitscope
+void VariableTable::enterscope() {
+    counts.scopes++;
+    scopeStarts.push_back(bindings.size());
+}
+
+// Removes the innermost scope, restoring whatever its bindings shadowed
+void VariableTable::exitscope() {
+    if(scopeStarts.empty()) {
+        fatal_error("exitscope: Can't remove scope from an empty symbol table.");
+    }
+
+    int start = scopeStarts.back();
+    scopeStarts.pop_back();
+
+    while((int) bindings.size() > start) {
+        Binding& last = bindings.back();
+        innermost[last.slot] = last.shadowed;
+        bindings.pop_back();
+    }
+}
+
+// Binds identifier to type in the innermost scope
+void VariableTable::addid(Symbol identifier, Symbol type) {
+    if(scopeStarts.empty()) {
+        fatal_error("addid: Can't add a symbol without a scope.");
+    }
+
+    int slot;
+    std::unordered_map<Symbol, int>::iterator found = slots.find(identifier);
+    if(found == slots.end()) {
+        slot = innermost.size();
+        slots[identifier] = slot;
+        innermost.push_back(-1);
+    } else {
+        slot = found->second;
+    }
+
+    Binding binding;
+    binding.slot = slot;
+    binding.type = type;
+    binding.shadowed = innermost[slot];
+
+    innermost[slot] = bindings.size();
+    bindings.push_back(binding);
+}
+
+// Type of the innermost binding of identifier, or NULL if it is not bound
+Symbol VariableTable::lookup(Symbol identifier) {
+    counts.variables++;
+
+    std::unordered_map<Symbol, int>::iterator found = slots.find(identifier);
+    if(found == slots.end() || innermost[found->second] < 0) return NULL;
+
+    return bindings[innermost[found->second]].type;
+}
+
+// Like lookup, but only considers bindings made in the innermost scope
+Symbol VariableTable::probe(Symbol identifier) {
+    counts.probes++;
+
+    if(scopeStarts.empty()) {
+        fatal_error("probe: No scope in symbol table.");
+    }
+
+    std::unordered_map<Symbol, int>::iterator found = slots.find(identifier);
+    if(found == slots.end() || innermost[found->second] < scopeStarts.back()) return NULL;
+
+    return bindings[innermost[found->second]].type;
+}
+
+
+// State of the search for reachable code, see findReachable
+struct Reachability {
+    ClassTable& table;
+    std::vector<Class__class*>& classes;
+    std::vector<int>& parents;
+    std::unordered_set<Feature_class*>& reached;
+
+    // Methods defined by each class itself, by name
+    std::vector< std::unordered_map<Symbol, Feature_class*> > ownMethods;
+    std::vector<bool> live;
+    std::unordered_set<Symbol> dispatched;
+    std::vector<Feature_class*> pending;
+
+    Reachability(ClassTable& t, std::vector<Class__class*>& c, std::vector<int>& p,
+                 std::unordered_set<Feature_class*>& r)
+        : table(t), classes(c), parents(p), reached(r),
+          ownMethods(c.size()), live(c.size(), false) {
+        for(unsigned int i = 0; i < classes.size(); i++) {
+            Features f = classes[i]->get_features();
+            for(int j = f->first(); f->more(j); j = f->next(j)) {
+                if(f->nth(j)->isMethod() && !ownMethods[i].count(f->nth(j)->get_name())) {
+                    ownMethods[i][f->nth(j)->get_name()] = f->nth(j);
+                }
+            }
+        }
+    }
+
+    // The method run when m is called on an object of class c
+    Feature_class* implementation(int c, Symbol m) {
+        for(; c >= 0; c = parents[c]) {
+            std::unordered_map<Symbol, Feature_class*>::iterator found = ownMethods[c].find(m);
+            if(found != ownMethods[c].end()) return found->second;
+        }
+        return NULL;
+    }
+
+    void reach(Feature_class* feature) {
+        if(feature != NULL && reached.insert(feature).second) pending.push_back(feature);
+    }
+
+    // Objects of class c may exist: their attributes are initialized, and
+    // every dispatch seen so far may land on c's methods
+    void create(int c) {
+        if(c < 0 || live[c]) return;
+        live[c] = true;
+
+        for(int a = c; a >= 0; a = parents[a]) {
+            Features f = classes[a]->get_features();
+            for(int j = f->first(); f->more(j); j = f->next(j)) {
+                if(!f->nth(j)->isMethod()) reach(f->nth(j));
+            }
+        }
+
+        for(std::unordered_set<Symbol>::iterator it = dispatched.begin();
+            it != dispatched.end(); it++) {
+            reach(implementation(c, *it));
+        }
+    }
+
+    // Methods called m may run on any object that may exist
+    void dispatch(Symbol m) {
+        if(!dispatched.insert(m).second) return;
+
+        for(unsigned int c = 0; c < classes.size(); c++) {
+            if(live[c]) reach(implementation(c, m));
+        }
+    }
+};
+
+// Finds the methods and attributes that may run when the program starts
+// at Main.main. Dispatch is resolved by name against the classes created
+// so far, so no types are needed. The basic classes are always live, since
+// constants and built-in methods create their objects. Without a
+// Main.main everything is checked
+void ClassTable::findReachable() {
+    Reachability search(*this, classNodes, parentIndices, reachableFeatures);
+
+    int mainClass = typeId(Main);
+    Feature_class* mainMethod = mainClass < 0 ? NULL : search.implementation(mainClass, main_meth);
+    if(mainMethod == NULL) return;
+
+    reachableOnly = true;
+
+    Symbol basic[] = { Object, IO, Int, Bool, Str };
+    for(unsigned int i = 0; i < sizeof(basic) / sizeof(basic[0]); i++) {
+        search.create(typeId(basic[i]));
+    }
+    search.create(mainClass);
+    search.reach(mainMethod);
+
+    while(!search.pending.empty()) {
+        Feature_class* feature = search.pending.back();
+        search.pending.pop_back();
+
+        std::vector<Expression_class*> nodes;
+        feature->get_expr()->collect_expressions(nodes);
+
+        ExpressionUses uses;
+        for(unsigned int i = 0; i < nodes.size(); i++) {
+            nodes[i]->collect_uses(uses);
+        }
+
+        // new SELF_TYPE creates an object of a class that already exists
+        for(unsigned int i = 0; i < uses.created.size(); i++) {
+            if(uses.created[i] != SELF_TYPE) search.create(typeId(uses.created[i]));
+        }
+        for(unsigned int i = 0; i < uses.staticallyDispatched.size(); i++) {
+            int c = typeId(uses.staticallyDispatched[i].first);
+            search.reach(search.implementation(c, uses.staticallyDispatched[i].second));
+        }
+        for(unsigned int i = 0; i < uses.dispatched.size(); i++) {
+            search.dispatch(uses.dispatched[i]);
+        }
+    }
+}
+
+void ClassTable::semanticAnalysis() {
+    Clock::time_point start = Clock::now();
+
+    if(semant_reachable) findReachable();
+    classTimes = std::vector<double>(classNodes.size(), 0);
+    methodTimes = std::vector< std::vector< std::pair<Symbol, double> > >(classNodes.size());
+
+    if(semant_jobs > 1) {
+        parallelAnalysis(semant_jobs);
+    } else {
+        // The same environment is reused for every class, each one leaves it
+        // empty when done
+        VariableTable variables;
+
+        for(unsigned int i = 0; i < classNodes.size(); i++) {
+            Clock::time_point classStart = Clock::now();
+            checkedClass = i;
+            classNodes[i]->semant(*this, variables);
+            classTimes[i] = millisecondsSince(classStart);
+        }
+        checkedClass = -1;
+    }
+
+    checkingTime = millisecondsSince(start);
+}
+
+// Checks the classes on a pool of threads. Classes only annotate their own
+// nodes and read the shared tables, so they can be checked in any order.
+// Each thread keeps its errors in a list of its own, and flushErrors puts
+// them back in class order to get the same output as the sequential run
+void ClassTable::parallelAnalysis(int jobs) {
+    int threads = std::min(jobs, (int) classNodes.size());
+    std::vector< std::vector<Diagnostic> > found(threads);
+    std::atomic<int> next(0);
+
+    parallel = true;
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&ClassTable::checkClasses, this,
+                                      std::ref(found[i]), std::ref(next)));
+    }
+    for(unsigned int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    parallel = false;
+
+    for(int i = 0; i < threads; i++) {
+        diagnostics.insert(diagnostics.end(), found[i].begin(), found[i].end());
+        semant_errors += found[i].size();
+    }
+}
+
+// Worker loop: every thread keeps taking the next class nobody has checked
+void ClassTable::checkClasses(std::vector<Diagnostic>& found, std::atomic<int>& next) {
+    VariableTable variables;
+    threadDiagnostics = &found;
+
+    for(int i = next++; i < (int) classNodes.size(); i = next++) {
+        checkedClass = i;
+
+        Clock::time_point start = Clock::now();
+        classNodes[i]->semant(*this, variables);
+        classTimes[i] = millisecondsSince(start);
+    }
+
+    threadDiagnostics = NULL;
+    checkedClass = -1;
+
+    std::lock_guard<std::mutex> lock(workerCountsLock);
+    workerCounts.lookups += counts.lookups;
+    workerCounts.conformance += counts.conformance;
+    workerCounts.joins += counts.joins;
+    workerCounts.scopes += counts.scopes;
+    workerCounts.variables += counts.variables;
+    workerCounts.probes += counts.probes;
+}
+
+// Records how long a method took to check. Only one thread checks each
+// class, so its list needs no locking
+void ClassTable::recordMethodTime(Class__class* c, Symbol method, double time) {
+    methodTimes[typeId(c->get_name())].push_back(std::make_pair(method, time));
+}
+
+static bool slowerFirst(const std::pair<double, std::string>& a,
+                        const std::pair<double, std::string>& b) {
+    return a.first > b.first;
+}
+
+// Prints the time taken by each phase, how many times each basic
+// operation was done, and the classes and methods that took the longest
+void ClassTable::printStatistics(ostream& out) {
+    const unsigned int shown = 10;
+
+    OperationCounts total = counts;
+    total.lookups += workerCounts.lookups;
+    total.conformance += workerCounts.conformance;
+    total.joins += workerCounts.joins;
+    total.scopes += workerCounts.scopes;
+    total.variables += workerCounts.variables;
+    total.probes += workerCounts.probes;
+
+    char line[256];
+    out << "Semantic analysis statistics\n";
+    snprintf(line, sizeof(line), "  %-22s %10.3f ms\n", "hierarchy", hierarchyTime);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10.3f ms\n", "cycle detection", cycleTime);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10.3f ms\n", "class checking", checkingTime);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "class lookups", total.lookups);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "conformance checks", total.conformance);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "joins", total.joins);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "scopes entered", total.scopes);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "variable lookups", total.variables);
+    out << line;
+    snprintf(line, sizeof(line), "  %-22s %10ld\n", "scope probes", total.probes);
+    out << line;
+
+    std::vector< std::pair<double, std::string> > classes, methods;
+    for(unsigned int i = 0; i < classTimes.size(); i++) {
+        std::string name = classNodes[i]->get_name()->get_string();
+        classes.push_back(std::make_pair(classTimes[i], name));
+
+        for(unsigned int j = 0; j < methodTimes[i].size(); j++) {
+            methods.push_back(std::make_pair(methodTimes[i][j].second,
+                              name + "." + methodTimes[i][j].first->get_string()));
+        }
+    }
+    std::stable_sort(classes.begin(), classes.end(), slowerFirst);
+    std::stable_sort(methods.begin(), methods.end(), slowerFirst);
+
+    out << "Slowest classes\n";
+    for(unsigned int i = 0; i < classes.size() && i < shown; i++) {
+        snprintf(line, sizeof(line), "  %10.3f ms  %s\n", classes[i].first, classes[i].second.c_str());
+        out << line;
+    }
+
+    out << "Slowest methods\n";
+    for(unsigned int i = 0; i < methods.size() && i < shown; i++) {
+        snprintf(line, sizeof(line), "  %10.3f ms  %s\n", methods[i].first, methods[i].second.c_str());
+        out << line;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//
+// Incremental checking
+//
+// With -i, the annotations and errors of every method are saved in
+// <cachedir>/<class>.sem, keyed by a hash of the method's text. Each
+// entry also lists the fingerprints of the classes the method looked at,
+// and it is only reused while all of them are unchanged.
+//
+//////////////////////////////////////////////////////////////////////
+
+// 64-bit FNV-1a hash in hex. Unlike std::hash it doesn't change between
+// runs, so it can be stored in the cache
+static std::string fingerprint(const std::string& text) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for(unsigned int i = 0; i < text.size(); i++) {
+        hash ^= (unsigned char) text[i];
+        hash *= 1099511628211ULL;
+    }
 
-        if(visited[current]) continue;
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", hash);
+    return buffer;
+}
 
-        visited[current] = 1;
+// A class's fingerprint includes its parent's, so a change to any ancestor
+// is seen by everything that depends on the class
+void ClassTable::buildFingerprints() {
+    std::vector<std::string> byIndex(classNodes.size());
+
+    for(unsigned int t = 0; t < topologicalOrder.size(); t++) {
+        int i = topologicalOrder[t];
+        Class__class* c = classNodes[i];
+
+        std::ostringstream signature;
+        signature << c->get_name() << " inherits " << c->get_parent() << "\n";
+        if(parentIndices[i] >= 0) signature << byIndex[parentIndices[i]] << "\n";
+
+        Features f = c->get_features();
+        for(int j = f->first(); f->more(j); j = f->next(j)) {
+            Feature_class* feature = f->nth(j);
+            signature << feature->get_name();
+
+            if(feature->isMethod()) {
+                Formals formals = feature->get_formals();
+                signature << "(";
+                for(int k = formals->first(); formals->more(k); k = formals->next(k)) {
+                    signature << formals->nth(k)->get_name() << ":"
+                              << formals->nth(k)->get_type_decl() << ",";
+                }
+                signature << ")";
+            }
 
-        for(unsigned int i = 0; i < graph.size(); i++) {
-            if(graph[i][current] && !visited[i]) toVisit.push_back(i);
+            signature << ":" << feature->get_ftype() << "\n";
         }
-    }
 
-    for(unsigned int i = 0; i < visited.size(); i++) {
-        if(!visited[i]) inCycle.push_back(i);
+        byIndex[i] = fingerprint(signature.str());
+        fingerprints[c->get_name()->get_string()] = byIndex[i];
     }
 
-    return inCycle.size();
+    std::ostringstream names;
+    for(unsigned int i = 0; i < classNodes.size(); i++) {
+        names << classNodes[i]->get_name() << "\n";
+    }
+    fingerprints["@classes"] = fingerprint(names.str());
 }
 
-// This creates the empty class list and checks the inheritance graph for errors
-ClassTable::ClassTable(Classes classes) : semant_errors(0) , error_stream(cerr) {
+struct CachedMethod {
+    // Names and fingerprints of the classes the method looked at
+    std::vector< std::pair<std::string, std::string> > dependencies;
+    // Type of each expression of the body, in preorder
+    std::vector<std::string> types;
+    std::vector<Diagnostic> errors;
+};
+
+struct ClassTable::MethodCache {
+    std::string path;
+    std::map<std::string, CachedMethod> previous;
+    std::map<std::string, CachedMethod> current;
+};
+
+// Loads the methods cached for a class, or returns NULL if there's no cache.
+// The basic classes and those loaded from interface summaries have no
+// method bodies, so they get no cache file
+ClassTable::MethodCache* ClassTable::openCache(Class__class* c) {
+    if(semant_cache_dir == NULL || precheckedFiles.count(c->get_filename())) return NULL;
+
+    MethodCache* cache = new MethodCache();
+    cache->path = std::string(semant_cache_dir) + "/" + c->get_name()->get_string() + ".sem";
+
+    // After a line with the format version, each method is stored as
+    //   method <key> <errors> <dependencies> <types>
+    // followed by one line per dependency and per type, and each error as
+    //   <line> <kind> <bytes of message>
+    // followed by the message. Errors are always in the file of the class
+    std::ifstream in(cache->path.c_str());
+    std::string tag, key, version;
+    int errors, dependencies, types, length;
+    CachedMethod entry;
+
+    if(!(in >> tag >> version) || tag != "semcache" || version != "2") return cache;
+
+    while(in >> tag >> key >> errors >> dependencies >> types && tag == "method") {
+        entry.dependencies.resize(dependencies);
+        for(int i = 0; i < dependencies; i++) {
+            in >> entry.dependencies[i].first >> entry.dependencies[i].second;
+        }
 
-    classList = nil_Classes();
+        entry.types.resize(types);
+        for(int i = 0; i < types; i++) {
+            in >> entry.types[i];
+        }
 
-    // First we install the basic classes
-    install_basic_classes();
+        entry.errors.resize(errors);
+        for(int i = 0; i < errors; i++) {
+            Diagnostic& error = entry.errors[i];
+            in >> error.line >> error.kind >> length;
+            in.get();
+            error.message = std::string(length, '\0');
+            if(length > 0) in.read(&error.message[0], length);
+            error.file = c->get_filename()->get_string();
+        }
 
-    // Now we add the user-defined classes
-    classList = Classes_class::append(classList, classes);
+        if(!in) break;
+        cache->previous[key] = entry;
+    }
 
-    // Map the classes
-    std::map<std::string, int> indices;
-    for(int i = classList->first(); classList->more(i); i = classList->next(i)) {
-        std::string thisName = classList->nth(i)->get_name()->get_string();
-        idtable.add_string(classList->nth(i)->get_name()->get_string());
-        if(indices.count(thisName) > 0) {
-            std::string fileName = std::string(classList->nth(i)->get_filename()->get_string());
-            int linenumber = classList->nth(i)->get_line_number();
-            semant_error() << fileName << ":" << linenumber << ": Class "
-                           << thisName << " was previously defined.\n";
-        } else {
-            indices[thisName] = i;
+    return cache;
+}
+
+// Checks a method, or reuses the results of the last run if neither the
+// method nor the classes it depends on have changed since
+void ClassTable::checkMethod(MethodCache* cache, Feature_class* method,
+                             VariableTable& variables, Class__class* currentClass) {
+    // The key covers the whole method, line numbers included, since they
+    // end up in the error messages
+    std::ostringstream text;
+    text << currentClass->get_filename() << "\n" << currentClass->get_name() << "\n";
+    method->dump_with_types(text, 0);
+    std::string key = fingerprint(text.str());
+
+    std::vector<Expression_class*> nodes;
+    method->get_expr()->collect_expressions(nodes);
+
+    std::map<std::string, CachedMethod>::iterator cached = cache->previous.find(key);
+    if(cached != cache->previous.end() && cached->second.types.size() == nodes.size()) {
+        CachedMethod& entry = cached->second;
+
+        bool upToDate = true;
+        for(unsigned int i = 0; i < entry.dependencies.size() && upToDate; i++) {
+            std::map<std::string, std::string>::iterator current =
+                fingerprints.find(entry.dependencies[i].first);
+            upToDate = current != fingerprints.end() &&
+                       current->second == entry.dependencies[i].second;
         }
-    }
 
-    // Create the inheritance graph
-    std::vector< std::vector<int> > G;
-    for(int i = classList->first(); classList->more(i); i = classList->next(i)) {
-        G.push_back(std::vector<int>(classList->len(), 0));
-        std::string thisName = std::string(classList->nth(i)->get_name()->get_string());
-        std::string parentName = std::string(classList->nth(i)->get_parent()->get_string());
-        std::string fileName = std::string(classList->nth(i)->get_filename()->get_string());
-        int linenumber = classList->nth(i)->get_line_number();
-        if(parentName != "_no_class") {
-            // Inheritance from invalid class
-            if(!indices.count(parentName)) {
-                semant_error() << fileName << ":" << linenumber << ": Class "
-                               << thisName << " inherits from an undefined class "
-                               << parentName << ".\n";
-            } else if(parentName == "Int" || parentName == "String" || parentName == "Bool" ) {
-                semant_error() << fileName << ":" << linenumber << ": Class "
-                               << thisName << " cannot inherit class "
-                               << parentName << ".\n";
-            } else {
-                G[indices[thisName]][indices[parentName]] = 1;
+        if(upToDate) {
+            for(unsigned int i = 0; i < nodes.size(); i++) {
+                if(entry.types[i] != "-") {
+                    Symbol type = idtable.add_string((char*) entry.types[i].c_str());
+                    nodes[i]->set_type(type, typeId(type));
+                }
             }
+
+            emitDiagnostics(entry.errors);
+            cache->current[key] = entry;
+            return;
         }
     }
 
-    std::vector<int> cycleClasses;
-    if(!errors() && findCycle(G, cycleClasses)) {
-        for(int i = cycleClasses.size() - 1; i >= 0; i--) {
-            int index = cycleClasses[i];
-            std::string thisName = classList->nth(index)->get_name()->get_string();
-            std::string fileName = classList->nth(index)->get_filename()->get_string();
-            int linenumber = classList->nth(index)->get_line_number();
-            semant_error() << fileName << ":" << linenumber << ": Class "
-                           << thisName << ", or an ancestor of " << thisName
-                           << ", is involved in an inheritance cycle.\n";
-        }
+    // Check the method, keeping track of its errors and of the classes it
+    // looks at. It always depends on its own class, whose attributes it sees
+    std::set<int> used;
+    CachedMethod entry;
+
+    std::vector<Diagnostic>* outerDiagnostics = threadDiagnostics;
+    threadDiagnostics = &entry.errors;
+    usedClasses = &used;
+
+    lookup(currentClass->get_name());
+    method->semant(*this, variables, currentClass);
+
+    threadDiagnostics = outerDiagnostics;
+    usedClasses = NULL;
+
+    for(std::set<int>::iterator it = used.begin(); it != used.end(); it++) {
+        std::string name = *it < 0 ? "@classes" : classNodes[*it]->get_name()->get_string();
+        entry.dependencies.push_back(std::make_pair(name, fingerprints[name]));
+    }
+    for(unsigned int i = 0; i < nodes.size(); i++) {
+        Symbol type = nodes[i]->get_type();
+        entry.types.push_back(type == NULL ? "-" : type->get_string());
     }
 
+    emitDiagnostics(entry.errors);
+    cache->current[key] = entry;
 }
 
-void ClassTable::install_basic_classes() {
+// Saves the methods of the class that was just checked
+void ClassTable::closeCache(MethodCache* cache) {
+    if(cache == NULL) return;
+
+    std::ofstream out(cache->path.c_str());
+    out << "semcache 2\n";
+    for(std::map<std::string, CachedMethod>::iterator it = cache->current.begin();
+        it != cache->current.end(); it++) {
+        CachedMethod& entry = it->second;
 
-    // The tree package uses these globals to annotate the classes built below.
-    curr_lineno  = 0;
-    Symbol filename = stringtable.add_string("<basic class>");
-    
-    // The following demonstrates how to create dummy parse trees to
-    // refer to basic Cool classes.  There's no need for method
-    // bodies -- these are already built into the runtime system.
-    
-    // IMPORTANT: The results of the following expressions are
-    // stored in local variables.  You will want to do something
-    // with those variables at the end of this method to make this
-    // code meaningful.
-
-    // 
-    // The Object class has no parent class. Its methods are
-    //        abort() : Object    aborts the program
-    //        type_name() : Str   returns a string representation of class name
-    //        copy() : SELF_TYPE  returns a copy of the object
-    //
-    // There is no need for method bodies in the basic classes---these
-    // are already built in to the runtime system.
-
-    Class_ Object_class =
-	class_(Object, 
-	       No_class,
-	       append_Features(
-			       append_Features(
-					       single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
-					       single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
-			       single_Features(method(copy, nil_Formals(), SELF_TYPE, no_expr()))),
-	       filename);
-
-    // 
-    // The IO class inherits from Object. Its methods are
-    //        out_string(Str) : SELF_TYPE       writes a string to the output
-    //        out_int(Int) : SELF_TYPE            "    an int    "  "     "
-    //        in_string() : Str                 reads a string from the input
-    //        in_int() : Int                      "   an int     "  "     "
-    //
-    Class_ IO_class = 
-	class_(IO, 
-	       Object,
-	       append_Features(
-			       append_Features(
-					       append_Features(
-							       single_Features(method(out_string, single_Formals(formal(arg, Str)),
-										      SELF_TYPE, no_expr())),
-							       single_Features(method(out_int, single_Formals(formal(arg, Int)),
-										      SELF_TYPE, no_expr()))),
-					       single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
-			       single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
-	       filename);  
-
-    //
-    // The Int class has no methods and only a single attribute, the
-    // "val" for the integer. 
-    //
-    Class_ Int_class =
-	class_(Int, 
-	       Object,
-	       single_Features(attr(val, prim_slot, no_expr())),
-	       filename);
-
-    //
-    // Bool also has only the "val" slot.
-    //
-    Class_ Bool_class =
-	class_(Bool, Object, single_Features(attr(val, prim_slot, no_expr())),filename);
-
-    //
-    // The class Str has a number of slots and operations:
-    //       val                                  the length of the string
-    //       str_field                            the string itself
-    //       length() : Int                       returns length of the string
-    //       concat(arg: Str) : Str               performs string concatenation
-    //       substr(arg: Int, arg2: Int): Str     substring selection
-    //       
-    Class_ Str_class =
-	class_(Str, 
-	       Object,
-	       append_Features(
-			       append_Features(
-					       append_Features(
-							       append_Features(
-									       single_Features(attr(val, Int, no_expr())),
-									       single_Features(attr(str_field, prim_slot, no_expr()))),
-							       single_Features(method(length, nil_Formals(), Int, no_expr()))),
-					       single_Features(method(concat, 
-								      single_Formals(formal(arg, Str)),
-								      Str, 
-								      no_expr()))),
-                               single_Features(method(substr,
-                                                      append_Formals(single_Formals(formal(arg, Int)),
-                                                                     single_Formals(formal(arg2, Int))),
-                                                      Str,
-                                                      no_expr()))),
-	       filename);
-
-
-    // In the end we add the basic classes to the class list
-    classList = Classes_class::append(classList, single_Classes(Object_class));
-    classList = Classes_class::append(classList, single_Classes(IO_class));
-    classList = Classes_class::append(classList, single_Classes(Int_class));
-    classList = Classes_class::append(classList, single_Classes(Bool_class));
-    classList = Classes_class::append(classList, single_Classes(Str_class));
+        out << "method " << it->first << " " << entry.errors.size() << " "
+            << entry.dependencies.size() << " " << entry.types.size() << "\n";
+        for(unsigned int i = 0; i < entry.dependencies.size(); i++) {
+            out << entry.dependencies[i].first << " " << entry.dependencies[i].second << "\n";
+        }
+        for(unsigned int i = 0; i < entry.types.size(); i++) {
+            out << entry.types[i] << "\n";
+        }
+        for(unsigned int i = 0; i < entry.errors.size(); i++) {
+            Diagnostic& error = entry.errors[i];
+            out << error.line << " " << error.kind << " " << error.message.size() << "\n"
+                << error.message;
+        }
+    }
+
+    delete cache;
 }
 
-////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
 //
-// semant_error is an overloaded function for reporting errors
-// during semantic analysis.  There are three versions:
+// Interface summaries
 //
-//    ostream& ClassTable::semant_error()                
+// With -e, the classes of every file of a program without errors are
+// summarized in <dir>/<file>.sum, together with a hash of the file and
+// one of the lines that follow the first:
 //
-//    ostream& ClassTable::semant_error(Class_ c)
-//       print line number and filename for `c'
+//   interface <file hash> <summary hash> <file>
+//   class <line> <name> <parent>
+//   attr <line> <name> <type>
+//   method <line> <name> <return type> <formals> {<name> <type>}
 //
-//    ostream& ClassTable::semant_error(Symbol filename, tree_node *t)  
-//       print a line number and filename
+// A summary given with -x stands in for its file: its classes are added
+// with empty bodies, like the basic classes, and are not checked again.
+// It is ignored if the file itself is part of the program, and rejected
+// if the summary was edited, or if the file is around and has changed
+// since the summary was written.
 //
-///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
 
-ostream& ClassTable::semant_error(Class_ c)
-{                                                             
-    return semant_error(c->get_filename(),c);
-}    
+// Reads a whole file, returning false if it can't be opened
+static bool readFile(const char* path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in) return false;
 
-ostream& ClassTable::semant_error(Symbol filename, tree_node *t)
-{
-    error_stream << filename << ":" << t->get_line_number() << ": ";
-    return semant_error();
+    std::ostringstream text;
+    text << in.rdbuf();
+    contents = text.str();
+    return true;
 }
 
-ostream& ClassTable::semant_error()                  
-{                                                 
-    semant_errors++;                            
-    return error_stream;
+void ClassTable::loadInterfaces(Classes classes) {
+    std::set<Symbol> sources;
+    for(int i = classes->first(); classes->more(i); i = classes->next(i)) {
+        sources.insert(classes->nth(i)->get_filename());
+    }
+
+    for(int i = 0; i < semant_interface_count; i++) {
+        loadInterface(semant_interfaces[i], sources);
+    }
 }
 
-// Checks if the given class exists and returns it
-Class__class* ClassTable::lookup(std::string className) {
-    for(int i = classList->first(); classList->more(i); i = classList->next(i)) {
-        std::string thisName = std::string(classList->nth(i)->get_name()->get_string());
+// Adds the classes of a summary to the class list
+void ClassTable::loadInterface(const char* path, const std::set<Symbol>& sources) {
+    std::string contents, line, tag, hash, summaryHash, source;
 
-        if(thisName == className) return classList->nth(i);
+    if(!readFile(path, contents)) {
+        semant_error(path, 0, "interface-unreadable") << "Cannot read interface summary.";
+        return;
     }
 
-    return NULL;
-}
+    std::istringstream in(contents);
+    std::getline(in, line);
+    std::istringstream header(line);
+    if(!(header >> tag >> hash >> summaryHash) || tag != "interface" ||
+       !std::getline(header >> std::ws, source)) {
+        semant_error(path, 1, "interface-malformed") << "Malformed interface summary.";
+        return;
+    }
 
-// Checks if a given class inherits from another (directly or indirectly)
-int ClassTable::inheritsFrom(std::string child, std::string parent) {
-    if(child == parent) return 1;
-    if(child == "Object") return 0;
+    Symbol filename = stringtable.add_string((char*) source.c_str());
+    if(sources.count(filename)) return;
 
-    for(int i = classList->first(); classList->more(i); i = classList->next(i)) {
-        std::string thisName = std::string(classList->nth(i)->get_name()->get_string());
-        std::string parentName = std::string(classList->nth(i)->get_parent()->get_string());
+    std::string::size_type bodyStart = contents.find('\n') + 1;
+    if(fingerprint(contents.substr(bodyStart)) != summaryHash) {
+        semant_error(path, 1, "interface-modified")
+                << "Interface summary was changed after it was written.";
+        return;
+    }
 
-        if(thisName == child) {
-            if(parentName == parent) {
-                return 1;
-            } else {
-                return inheritsFrom(parentName, parent);
+    // A library may be shipped without its source, but a source that is
+    // around must be the one the summary was made from
+    std::string sourceContents;
+    if(readFile(source.c_str(), sourceContents) && fingerprint(sourceContents) != hash) {
+        semant_error(path, 1, "interface-stale")
+                << "Interface summary is out of date with " << source << ".";
+        return;
+    }
+
+    // The classes are only added once the whole summary has been read
+    Classes loaded = nil_Classes();
+    Symbol name = NULL, parent = NULL;
+    Features features = NULL;
+    int classLine = 0;
+
+    for(int lineNumber = 2; std::getline(in, line); lineNumber++) {
+        std::istringstream fields(line);
+        std::string first, second, third;
+        int featureLine;
+
+        if(!(fields >> tag >> featureLine >> first >> second) ||
+           (tag != "class" && features == NULL)) {
+            semant_error(path, lineNumber, "interface-malformed") << "Malformed interface summary.";
+            return;
+        }
+
+        node_lineno = featureLine;
+        Symbol featureName = idtable.add_string((char*) first.c_str());
+        Symbol type = idtable.add_string((char*) second.c_str());
+
+        if(tag == "class") {
+            if(features != NULL) {
+                node_lineno = classLine;
+                loaded = append_Classes(loaded, single_Classes(class_(name, parent, features, filename)));
+            }
+            name = featureName;
+            parent = type;
+            features = nil_Features();
+            classLine = featureLine;
+        } else if(tag == "attr") {
+            features = append_Features(features, single_Features(attr(featureName, type, no_expr())));
+        } else if(tag == "method") {
+            Formals formals = nil_Formals();
+            int count = -1;
+            fields >> count;
+            for(int i = 0; i < count && fields >> first >> third; i++) {
+                formals = append_Formals(formals, single_Formals(
+                    formal(idtable.add_string((char*) first.c_str()),
+                           idtable.add_string((char*) third.c_str()))));
             }
+            if(!fields || formals->len() != count) {
+                semant_error(path, lineNumber, "interface-malformed") << "Malformed interface summary.";
+                return;
+            }
+            features = append_Features(features, single_Features(
+                method(featureName, formals, type, no_expr())));
+        } else {
+            semant_error(path, lineNumber, "interface-malformed") << "Malformed interface summary.";
+            return;
         }
     }
 
-    return 0;
+    if(features != NULL) {
+        node_lineno = classLine;
+        loaded = append_Classes(loaded, single_Classes(class_(name, parent, features, filename)));
+    }
+
+    classList = append_Classes(classList, loaded);
+    precheckedFiles.insert(filename);
 }
 
-// Finds the most specific class which is a parent to both class c1 and c2
-Class__class* ClassTable::nearestCommonParent(std::string c1, std::string c2) {
-    std::vector<char*> visited = std::vector<char*>();
-    Class__class* currentClass = lookup(c1);
+void ClassTable::writeInterfaces() {
+    // Bodies skipped by -u were never checked
+    if(semant_interface_dir == NULL || reachableOnly) return;
 
-    while(std::string(currentClass->get_parent()->get_string()) != "_no_class") {
-        char* currentName = currentClass->get_name()->get_string();
-        char* parentName = currentClass->get_parent()->get_string();
-        visited.push_back(currentName);
+    // Classes of each file, in the order the files first appear
+    std::vector<Symbol> files;
+    std::map<Symbol, std::vector<Class__class*> > classesByFile;
+    for(unsigned int i = 0; i < classNodes.size(); i++) {
+        Symbol filename = classNodes[i]->get_filename();
+        if(precheckedFiles.count(filename)) continue;
 
-        currentClass = lookup(parentName);
+        if(classesByFile.count(filename) == 0) files.push_back(filename);
+        classesByFile[filename].push_back(classNodes[i]);
     }
-    visited.push_back("Object");
-
-    currentClass = lookup(c2);
-    while(std::string(currentClass->get_parent()->get_string()) != "_no_class") {
-        char* currentName = currentClass->get_name()->get_string();
-        char* parentName = currentClass->get_parent()->get_string();
 
-        if(std::find(visited.begin(), visited.end(), currentName) != visited.end()) {
-            return currentClass;
+    for(unsigned int i = 0; i < files.size(); i++) {
+        // Programs read from the standard input have no file to hash
+        std::string source = files[i]->get_string();
+        std::string contents;
+        if(!readFile(source.c_str(), contents)) continue;
+
+        std::string path = std::string(semant_interface_dir) + "/" +
+                           source.substr(source.find_last_of('/') + 1) + ".sum";
+        std::ostringstream out;
+
+        std::vector<Class__class*>& fileClasses = classesByFile[files[i]];
+        for(unsigned int j = 0; j < fileClasses.size(); j++) {
+            Class__class* c = fileClasses[j];
+            out << "class " << c->get_line_number() << " " << c->get_name()
+                << " " << c->get_parent() << "\n";
+
+            Features f = c->get_features();
+            for(int k = f->first(); f->more(k); k = f->next(k)) {
+                Feature_class* feature = f->nth(k);
+                out << (feature->isMethod() ? "method " : "attr ")
+                    << feature->get_line_number() << " " << feature->get_name()
+                    << " " << feature->get_ftype();
+
+                if(feature->isMethod()) {
+                    Formals formals = feature->get_formals();
+                    out << " " << formals->len();
+                    for(int l = formals->first(); formals->more(l); l = formals->next(l)) {
+                        out << " " << formals->nth(l)->get_name()
+                            << " " << formals->nth(l)->get_type_decl();
+                    }
+                }
+                out << "\n";
+            }
         }
 
-        currentClass = lookup(parentName);
+        std::ofstream summary(path.c_str());
+        summary << "interface " << fingerprint(contents) << " "
+                << fingerprint(out.str()) << " " << source << "\n" << out.str();
     }
+}
 
-    return lookup("Object");
+// Lists the expressions of a tree in preorder, so that cached types can be
+// matched back to the nodes they belong to
+void assign_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    expr->collect_expressions(nodes);
 }
 
-// Finds a method belonging to c or one of it's ancestors
-Feature_class* ClassTable::findMethod(std::string c, std::string m) {
-    Feature_class* found = NULL;
-    Class__class* currentClass;
-    std::string parentClass = c;
-
-    do {
-        currentClass = lookup(parentClass);
-
-        Features f = currentClass->get_features();
-        for(int i = f->first(); f->more(i); i = f->next(i)) {
-            if(f->nth(i)->isMethod() && std::string(f->nth(i)->get_name()->get_string()) == m) {
-                found = f->nth(i);
-            }
-        }
+void static_dispatch_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    expr->collect_expressions(nodes);
+    for(int i = actual->first(); actual->more(i); i = actual->next(i)) {
+        actual->nth(i)->collect_expressions(nodes);
+    }
+}
+
+void dispatch_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    expr->collect_expressions(nodes);
+    for(int i = actual->first(); actual->more(i); i = actual->next(i)) {
+        actual->nth(i)->collect_expressions(nodes);
+    }
+}
 
-        parentClass = currentClass->get_parent()->get_string();
-    } while(parentClass != "_no_class");
+void cond_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    pred->collect_expressions(nodes);
+    then_exp->collect_expressions(nodes);
+    else_exp->collect_expressions(nodes);
+}
 
-    return found;
+void loop_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    pred->collect_expressions(nodes);
+    body->collect_expressions(nodes);
 }
 
+void typcase_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    expr->collect_expressions(nodes);
+    for(int i = cases->first(); cases->more(i); i = cases->next(i)) {
+        cases->nth(i)->get_expr()->collect_expressions(nodes);
+    }
+}
 
-void ClassTable::semanticAnalysis() {
-    for(int i = classList->first(); classList->more(i); i = classList->next(i)) {
-        classList->nth(i)->semant(*this);
+void block_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    for(int i = body->first(); body->more(i); i = body->next(i)) {
+        body->nth(i)->collect_expressions(nodes);
     }
 }
 
+void let_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    init->collect_expressions(nodes);
+    body->collect_expressions(nodes);
+}
+
+void plus_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void sub_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void mul_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void divide_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void neg_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+}
+
+void lt_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void eq_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void leq_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+    e2->collect_expressions(nodes);
+}
+
+void comp_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+}
+
+void int_const_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+void bool_const_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+void string_const_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+void new__class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+void isvoid_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+    e1->collect_expressions(nodes);
+}
+
+void no_expr_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+void object_class::collect_expressions(std::vector<Expression_class*>& nodes) {
+    nodes.push_back(this);
+}
+
+// Records the classes and methods used by an expression itself (not by
+// its subexpressions), to find reachable code
+void static_dispatch_class::collect_uses(ExpressionUses& uses) {
+    uses.staticallyDispatched.push_back(std::make_pair(type_name, name));
+}
+
+void dispatch_class::collect_uses(ExpressionUses& uses) {
+    uses.dispatched.push_back(name);
+}
+
+void new__class::collect_uses(ExpressionUses& uses) {
+    uses.created.push_back(type_name);
+}
+
 
 // Semantic analysis for a single class
-void class__class::semant(ClassTable& classes) {
-    SymbolTable<char*, Feature_class> *methods = new SymbolTable<char*, Feature_class>();
-    SymbolTable<std::string, char*> *variables = new SymbolTable<std::string, char*>();
+void class__class::semant(ClassTable& classes, VariableTable& variables) {
+    SymbolTable<Symbol, Feature_class> *methods = new SymbolTable<Symbol, Feature_class>();
 
-    variables->enterscope();
+    variables.enterscope();
     methods->enterscope();
 
-    char* currentClassName = this->get_name()->get_string();
-    variables->addid(self->get_string(), &currentClassName);
+    variables.addid(self, name);
+
+    // Inherited attributes aren't bound here: identifierType looks them up
+    // in the class table when no binding is found
+    variables.enterscope();
+
     // First we store the available methods and attributes
     for(int i = features->first(); features->more(i); i = features->next(i)) {
-        char* featName = features->nth(i)->get_name()->get_string();
+        Symbol featName = features->nth(i)->get_name();
 
         if(features->nth(i)->isMethod()) {
             if(methods->probe(featName) == NULL) {
-                methods->addid(idtable.lookup_string(featName)->get_string(), features->nth(i));
-                idtable.add_string(featName);
+                methods->addid(featName, features->nth(i));
             } else {
-                classes.semant_error() << get_filename() << ":" << features->nth(i)->get_line_number()
-                     << ": Method " << featName << " is multiply defined.\n";
+                classes.semant_error(get_filename(), features->nth(i)->get_line_number(), "method-redefined")
+                     << "Method " << featName << " is multiply defined.";
             }
         } else {
-            if(variables->probe(featName) == NULL) {
-                char** ftype = new char*;
-                *ftype = features->nth(i)->get_ftype()->get_string();
-                variables->addid(idtable.lookup_string(featName)->get_string(),
-                                 ftype);
-                idtable.add_string(featName);
+            if(variables.probe(featName) == NULL) {
+                variables.addid(featName, features->nth(i)->get_ftype());
             } else {
-                classes.semant_error() << get_filename() << ":" << features->nth(i)->get_line_number()
-                     << ": Attribute " << featName << " is multiply defined.\n";
+                classes.semant_error(get_filename(), features->nth(i)->get_line_number(), "attribute-redefined")
+                     << "Attribute " << featName << " is multiply defined.";
             }
         }
     }
 
-    // Finally we check to see if any methods were incorrectly overwritten
+    // Finally we check to see if any methods were incorrectly overwritten.
+    // The parent's method table holds the original definition of each method
     for(int i = features->first(); features->more(i); i = features->next(i)) {
-        Class__class* current = this;
         Feature_class* overwritten = NULL;
 
-        do {
-            if(std::string(current->get_parent()->get_string()) == "_no_class") break;
-            current = classes.lookup(current->get_parent()->get_string());
-            Features currentFeats = current->get_features();
-
-            for(int j = currentFeats->first(); currentFeats->more(j); j = currentFeats->next(j)) {
-                if(currentFeats->nth(j)->isMethod() &&
-                   std::string(currentFeats->nth(j)->get_name()->get_string()) ==
-                   std::string(features->nth(i)->get_name()->get_string())
-                   ) {
-                    overwritten = currentFeats->nth(j);
-                    break;
-                }
-            }
-
-        } while(std::string(current->get_parent()->get_string()) != "_no_class");
+        if(parent != No_class) {
+            overwritten = classes.findMethod(parent, features->nth(i)->get_name());
+        }
 
         if(overwritten != NULL) {
             Formals currentFormals = features->nth(i)->get_formals();
             Formals overFormals = overwritten->get_formals();
 
-            if(std::string(features->nth(i)->get_ftype()->get_string()) !=
-               std::string(overwritten->get_ftype()->get_string())) {
-                classes.semant_error() << get_filename() << ":" << get_line_number()
-                     << ": In redefined method " << features->nth(i)->get_name()->get_string()
-                     << ", return type " << features->nth(i)->get_ftype()->get_string()
+            if(features->nth(i)->get_ftype() != overwritten->get_ftype()) {
+                classes.semant_error(get_filename(), get_line_number(), "override-return-type")
+                     << "In redefined method " << features->nth(i)->get_name()
+                     << ", return type " << features->nth(i)->get_ftype()
                      << " is different from original return type "
-                     << overwritten->get_ftype()->get_string() << ".\n";
+                     << overwritten->get_ftype() << ".";
             } else if(overFormals->len() != currentFormals->len()) {
-                classes.semant_error() << get_filename() << ":" << get_line_number()
-                     << ": Incompatible number of formal parameters in redefined method "
-                     << features->nth(i)->get_name()->get_string() << ".\n";
+                classes.semant_error(get_filename(), get_line_number(), "override-formal-count")
+                     << "Incompatible number of formal parameters in redefined method "
+                     << features->nth(i)->get_name() << ".";
 
             } else {
                 for(int j = currentFormals->first(), k = overFormals->first();
                     currentFormals->more(j);
                     j = currentFormals->next(j), k = overFormals->next(k)) {
 
-                    if(std::string(overFormals->nth(k)->get_type_decl()->get_string()) !=
-                        std::string(currentFormals->nth(j)->get_type_decl()->get_string())
-                        ) {
+                    if(overFormals->nth(k)->get_type_decl() !=
+                       currentFormals->nth(j)->get_type_decl()) {
                         // Formals don't match
-                        classes.semant_error() << get_filename() << ":" << get_line_number()
-                             << ": In redefined method " << features->nth(i)->get_name()->get_string()
-                             << ", parameter type " << currentFormals->nth(j)->get_type_decl()->get_string()
+                        classes.semant_error(get_filename(), get_line_number(), "override-formal-type")
+                             << "In redefined method " << features->nth(i)->get_name()
+                             << ", parameter type " << currentFormals->nth(j)->get_type_decl()
                              << " is different from original type "
-                             << overFormals->nth(k)->get_type_decl()->get_string() << "\n";
+                             << overFormals->nth(k)->get_type_decl();
                         break;
 
                     }
@@ -513,44 +1805,60 @@ void class__class::semant(ClassTable& classes) {
     }
 
     // Now we do the semantic analysis for each feature
+    ClassTable::MethodCache* cache = classes.openCache(this);
     for(int i = features->first(); features->more(i); i = features->next(i)) {
-        features->nth(i)->semant(classes, *variables, this);
+        Feature_class* feature = features->nth(i);
+        Clock::time_point start = Clock::now();
+
+        if(cache != NULL && feature->isMethod() && classes.isReachable(feature)) {
+            classes.checkMethod(cache, feature, variables, this);
+        } else {
+            feature->semant(classes, variables, this);
+        }
+
+        if(semant_debug && feature->isMethod()) {
+            classes.recordMethodTime(this, feature->get_name(), millisecondsSince(start));
+        }
     }
+    classes.closeCache(cache);
 
-    variables->exitscope();
+    variables.exitscope();
+    variables.exitscope();
     methods->exitscope();
 
-    delete variables;
     delete methods;
 }
 
 // Semantic analysis for an attribute
 void attr_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
+    // Attributes of classes that are never created are not checked
+    if(!classes.isReachable(this)) return;
+
     Expression init = get_expr();
     int success = init->semant(classes, variables, currentClass);
 
     if(init->get_type() != NULL) {
         // We have an initialization
-        std::string declared_type = std::string(type_decl->get_string());
-        std::string actual_type = std::string(init->get_type()->get_string());
+        Symbol declared_type = type_decl;
+        Symbol actual_type = init->get_type();
 
-        if(declared_type == "SELF_TYPE") declared_type =  currentClass->get_name()->get_string();
+        if(declared_type == SELF_TYPE) declared_type = currentClass->get_name();
 
         if(classes.lookup(declared_type) == NULL) {
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": Class " << declared_type << " of attribute "
-                 << get_name() << " is undefined.\n";
+            classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-attribute-type")
+                 << "Class " << declared_type << " of attribute "
+                 << get_name() << " is undefined.";
         }
 
-        if(success && actual_type != "_no_type"){
+        if(success && actual_type != No_type){
 
             if(classes.lookup(declared_type) != NULL) {
-                if(!classes.inheritsFrom(actual_type, declared_type)) {
-                    classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                         << ": Inferred type " << actual_type << " of initialization of"
+                if(!classes.conforms(init, declared_type)) {
+                    classes.semant_error(currentClass->get_filename(), get_line_number(), "attribute-type")
+                         << "Inferred type " << actual_type << " of initialization of"
                          << "attribute " << get_name() << " does not conform to declared type "
-                         << type_decl->get_string() << ".\n";
+                         << type_decl << ".";
                 }
             }
 
@@ -560,33 +1868,45 @@ void attr_class::semant(ClassTable& classes,
 
 // Semantic analysis for a method
 void method_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     variables.enterscope();
 
     // Add the function formal parameters to the symbol table
-    Formals f = get_formals();
     for(int i = formals->first(); formals->more(i); i = formals->next(i)) {
 
-        std::string formalName = formals->nth(i)->get_name()->get_string();
-        char** formalType = new char*;
-        *formalType = formals->nth(i)->get_type_decl()->get_string();
+        Symbol formalName = formals->nth(i)->get_name();
+        Symbol formalType = formals->nth(i)->get_type_decl();
 
-        if(classes.lookup(*formalType) == NULL) {
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": Class " << *formalType << " of formal parameter "
-                 << formalName << " is undefined.\n";
+        if(classes.lookup(formalType) == NULL) {
+            classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-formal-type")
+                 << "Class " << formalType << " of formal parameter "
+                 << formalName << " is undefined.";
         }
 
         if(variables.probe(formalName) == NULL) {
             variables.addid(formalName, formalType);
-            idtable.add_string(formals->nth(i)->get_name()->get_string());
         } else {
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": Formal parameter " << formalName << " is multiply defined.\n";
+            classes.semant_error(currentClass->get_filename(), get_line_number(), "formal-redefined")
+                 << "Formal parameter " << formalName << " is multiply defined.";
         }
     }
 
+    // Methods that can't be reached from Main.main only get their
+    // signature checked
+    if(!classes.isReachable(this)) {
+        Symbol methodType = get_ftype();
+        if(methodType == SELF_TYPE) methodType = currentClass->get_name();
+
+        if(classes.lookup(methodType) == NULL) {
+            classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-return-type")
+                 << "Undefined return type " << get_ftype()
+                 << " in method " << get_name() << ".";
+        }
+
+        variables.exitscope();
+        return;
+    }
 
     // Evaluate method body and check if its type corresponds to the method type
     get_expr()->semant(classes, variables, currentClass);
@@ -594,23 +1914,23 @@ void method_class::semant(ClassTable& classes,
     // We must not check basic classes' methods
     if(get_expr()->get_type() != NULL) {
 
-        char* expressionType = get_expr()->get_type()->get_string();
-        char* methodType = get_ftype()->get_string();
+        Symbol expressionType = get_expr()->get_type();
+        Symbol methodType = get_ftype();
 
-        if(std::string(methodType) == "SELF_TYPE") methodType = currentClass->get_name()->get_string();
+        if(methodType == SELF_TYPE) methodType = currentClass->get_name();
 
         if(classes.lookup(methodType) != NULL) {
-            if(!classes.inheritsFrom(expressionType, methodType)) {
-                classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                     << ": Inferred return type " << expressionType
-                     << " of method " << get_name()->get_string()
+            if(!classes.conforms(get_expr(), methodType)) {
+                classes.semant_error(currentClass->get_filename(), get_line_number(), "return-type")
+                     << "Inferred return type " << expressionType
+                     << " of method " << get_name()
                      << " does not conform to declared return type "
-                     << get_ftype()->get_string() << ".\n";
+                     << get_ftype() << ".";
             }
         } else {
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": Undefined return type " << get_ftype()->get_string()
-                 << " in method " << get_name()->get_string() << ".\n";
+            classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-return-type")
+                 << "Undefined return type " << get_ftype()
+                 << " in method " << get_name() << ".";
         }
 
     }
@@ -620,65 +1940,108 @@ void method_class::semant(ClassTable& classes,
 
 // Semantic analysis for a case branch
 void branch_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     variables.enterscope();
 
-    std::string varName = get_name()->get_string();
-    std::string varType = get_type_decl()->get_string();
-    if(varType == "SELF_TYPE") varType = currentClass->get_name()->get_string();
+    Symbol varType = get_type_decl();
+    if(varType == SELF_TYPE) varType = currentClass->get_name();
 
     if(classes.lookup(varType) == NULL) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Class " << varType << " of case branch "
-             << varName << " is undefined.\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-branch-type")
+             << "Class " << varType << " of case branch "
+             << get_name() << " is undefined.";
     }
 
-    char** vType = new char*;
-    *vType = get_type_decl()->get_string();
-    if(std::string(*vType) == "SELF_TYPE") *vType = currentClass->get_name()->get_string();
-
-    variables.addid(get_name()->get_string(), vType);
-    idtable.add_string(get_name()->get_string());
+    variables.addid(get_name(), varType);
 
     get_expr()->semant(classes, variables, currentClass);
 
     variables.exitscope();
 }
 
+// Declared type of an identifier: its innermost binding or, when it has
+// none, an attribute the class inherits
+static Symbol identifierType(ClassTable& classes, VariableTable& variables,
+                             Class__class* currentClass, Symbol name) {
+    Symbol type = variables.lookup(name);
+    if(type != NULL) return type;
+
+    Feature_class* attribute = classes.findAttribute(classes.typeId(currentClass->get_name()), name);
+    return attribute == NULL ? NULL : attribute->get_ftype();
+}
+
 // Semantic analysis for an assignment
 int assign_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     // We evaluate the expression on the right hand side
     int subResult = get_expr()->semant(classes, variables, currentClass);
 
-    char* leftType = *variables.lookup(get_name()->get_string());
-    char* rightType = get_expr()->get_type()->get_string();
+    Symbol leftType = identifierType(classes, variables, currentClass, get_name());
+    Symbol rightType = get_expr()->get_type();
 
     if(leftType == NULL) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Assignment to undeclared variable "
-             << get_name()->get_string() << ".\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undeclared-variable")
+             << "Assignment to undeclared variable "
+             << get_name() << ".";
+
+        set_type(Object, classes.typeId(Object));
+        return 0;
     }
 
-    if(subResult && leftType != NULL && classes.lookup(leftType) != NULL &&
-        !classes.inheritsFrom(rightType, leftType)) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Type " << rightType << " of assigned expression does not "
+    if(subResult && classes.lookup(leftType) != NULL &&
+        !classes.conforms(get_expr(), leftType)) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "assignment-type")
+             << "Type " << rightType << " of assigned expression does not "
              << "conform to declared type " << leftType << " of identifier "
-             << get_name()->get_string() << ".\n";
+             << get_name() << ".";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
         return 0;
     }
 
-    set_type(idtable.lookup_string(leftType));
+    set_type(leftType, classes.typeId(leftType));
 
     return subResult;
 }
 
+// Checks the actual parameters of a call against the formals of method m
+static int checkActuals(ClassTable& classes, Class__class* currentClass, tree_node* call,
+                        Symbol name, Feature_class* m, Expressions actual) {
+    Formals form = m->get_formals();
+
+    // Check if the number of parameters is the same
+    if(form->len() != actual->len()) {
+        classes.semant_error(currentClass->get_filename(), call->get_line_number(), "argument-count")
+             << "Method " << name << " called with wrong number of arguments.";
+
+        return 0;
+    }
+
+    // Check if parameters match
+    int match = 1;
+    for(int i = form->first(), j = actual->first();
+        form->more(i);
+        i = form->next(i), j = actual->next(j)) {
+
+        if(!classes.conforms(actual->nth(j), form->nth(i)->get_type_decl())) {
+            // Parameters don't match
+            classes.semant_error(currentClass->get_filename(), call->get_line_number(), "argument-type")
+                 << "In call of method " << name
+                 << ", type " << actual->nth(j)->get_type()
+                 << " of parameter " << form->nth(i)->get_name()
+                 << " does not conform to declared type " << form->nth(i)->get_type_decl()
+                 << ".";
+
+            match = 0;
+        }
+    }
+
+    return match;
+}
+
 // Semantic analysis for static method dispatch
 int static_dispatch_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     // We evaluate the expression on the left hand side
     int success = expr->semant(classes, variables, currentClass);
 
@@ -686,91 +2049,56 @@ int static_dispatch_class::semant(ClassTable& classes,
         success = actual->nth(i)->semant(classes, variables, currentClass) && success;
     }
 
-    std::string leftType = expr->get_type()->get_string();
+    Symbol leftType = expr->get_type();
 
-    if(leftType == "SELF_TYPE") leftType = currentClass->get_name()->get_string();
+    if(leftType == SELF_TYPE) leftType = currentClass->get_name();
 
-    std::string staticType = type_name->get_string();
+    Symbol staticType = type_name;
 
     // Does not allow method call to static type "SELF_TYPE"
-    if(staticType == "SELF_TYPE") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Static dispatch to SELF_TYPE.\n";
+    if(staticType == SELF_TYPE) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "static-dispatch-self-type")
+             << "Static dispatch to SELF_TYPE.";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
 
         return 0;
     }
 
     // Check if left hand side type conforms to specified static type
     if(!classes.inheritsFrom(leftType, staticType)) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Expression type " << leftType
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "static-dispatch-type")
+             << "Expression type " << leftType
              << " does not conform to declared static dispatch type "
-             << staticType << ".\n";
+             << staticType << ".";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
 
         return 0;
     }
 
-    Feature_class* m = classes.findMethod(staticType, name->get_string());
+    Feature_class* m = classes.findMethod(staticType, name);
 
     if(m == NULL) {
         // No matching method found
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Static dispatch to undefined method " << name->get_string() << ".\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-method")
+             << "Static dispatch to undefined method " << name << ".";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
 
         return 0;
     } 
 
-    std::string returnType = m->get_ftype()->get_string();
-    set_type(idtable.lookup_string(m->get_ftype()->get_string()));
-    if(returnType == "SELF_TYPE") {
-        returnType = staticType;
-        set_type(idtable.lookup_string(type_name->get_string()));
-    }
-
-    Formals form = m->get_formals();
-
-    // Check if the number of parameters is the same
-    if(form->len() != actual->len()) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Method " << name->get_string() << " called with wrong number of arguments.\n";
-
-        return 0;
-    }    
-
-    // Check if parameters match
-    int match = 1;
-    for(int i = form->first(), j = actual->first();
-        form->more(i);
-        i = form->next(i), j = actual->next(j)) {
-
-        if(!classes.inheritsFrom(actual->nth(j)->get_type()->get_string(),
-            form->nth(i)->get_type_decl()->get_string())
-            ) {
-            // Parameters don't match
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": In call of method " << name->get_string()
-                 << ", type " << actual->nth(j)->get_type()->get_string()
-                 << " of parameter " << form->nth(i)->get_name()->get_string()
-                 << " does not conform to declared type " << form->nth(i)->get_type_decl()->get_string()
-                 << ".\n";
-
-            match = 0;
-        }
-    }
+    set_type(m->get_ftype(), classes.typeId(m->get_ftype()));
+    if(m->get_ftype() == SELF_TYPE) set_type(type_name, classes.typeId(type_name));
 
-    return match;
+    return checkActuals(classes, currentClass, this, name, m, actual);
 
 }
 
 // Semantic analysis for method dispatch
 int dispatch_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     // We evaluate the expression on the left hand side
     int success = expr->semant(classes, variables, currentClass);
 
@@ -778,470 +2106,386 @@ int dispatch_class::semant(ClassTable& classes,
         success = actual->nth(i)->semant(classes, variables, currentClass) && success;
     }
 
-    std::string leftType = expr->get_type()->get_string();
+    int leftType = expr->get_type_id();
 
-    if(leftType == "SELF_TYPE") leftType = currentClass->get_name()->get_string();
+    if(leftType == ClassTable::SELF_TYPE_ID) leftType = classes.typeId(currentClass->get_name());
 
-    Feature_class* m = classes.findMethod(leftType, name->get_string());
+    Feature_class* m = classes.findMethod(leftType, name);
 
     if(m == NULL) {
         // No matching method found
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Dispatch to undefined method " << name->get_string() << ".\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-method")
+             << "Dispatch to undefined method " << name << ".";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
 
         return 0;
     } 
 
-    std::string returnType = m->get_ftype()->get_string();
-    set_type(idtable.lookup_string(m->get_ftype()->get_string()));
-    if(returnType == "SELF_TYPE") {
-        returnType = leftType;
-        set_type(idtable.lookup_string(expr->get_type()->get_string()));
-        if(leftType == "SELF_TYPE") {
-            set_type(idtable.lookup_string(currentClass->get_name()->get_string()));
-        }
-    }
-
-    Formals form = m->get_formals();
-
-    // Check if the number of parameters is the same
-    if(form->len() != actual->len()) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Method " << name->get_string() << " called with wrong number of arguments.\n";
-
-        return 0;
-    }    
-
-    // Check if parameters match
-    int match = 1;
-    for(int i = form->first(), j = actual->first();
-        form->more(i);
-        i = form->next(i), j = actual->next(j)) {
-
-        if(!classes.inheritsFrom(actual->nth(j)->get_type()->get_string(),
-            form->nth(i)->get_type_decl()->get_string())
-            ) {
-            // Parameters don't match
-            classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-                 << ": In call of method " << name->get_string()
-                 << ", type " << actual->nth(j)->get_type()->get_string()
-                 << " of parameter " << form->nth(i)->get_name()->get_string()
-                 << " does not conform to declared type " << form->nth(i)->get_type_decl()->get_string()
-                 << ".\n";
-
-            match = 0;
-        }
-    }
+    set_type(m->get_ftype(), classes.typeId(m->get_ftype()));
+    if(m->get_ftype() == SELF_TYPE) set_type(expr->get_type(), expr->get_type_id());
 
-    return match;
+    return checkActuals(classes, currentClass, this, name, m, actual);
 
 }
 
 // Semantic analysis for a conditional
 int cond_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     int success = get_pred()->semant(classes, variables, currentClass);
     success = get_then_exp()->semant(classes, variables, currentClass) && success;
     success = get_else_exp()->semant(classes, variables, currentClass) && success;
 
-    char* predType = get_pred()->get_type()->get_string();
-    if(std::string(predType) != "Bool") {
+    if(get_pred()->get_type() != Bool) {
         success = 0;
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Predicate of 'if' does not have type Bool.\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "predicate-type")
+             << "Predicate of 'if' does not have type Bool.";
     }
 
-    Class__class* common = classes.nearestCommonParent(get_then_exp()->get_type()->get_string(),
-                                         get_else_exp()->get_type()->get_string());
-    set_type(idtable.lookup_string(common->get_name()->get_string()));
+    int common = classes.join(get_then_exp()->get_type_id(), get_else_exp()->get_type_id());
+    set_type(classes.typeName(common), common);
 
     return success;
 }
 
 // Semantic analysis for a loop
 int loop_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = get_pred()->semant(classes, variables, currentClass);
     success = get_body()->semant(classes, variables, currentClass) && success;
 
-    char* predType = get_pred()->get_type()->get_string();
-    if(std::string(predType) != "Bool") {
+    if(get_pred()->get_type() != Bool) {
         success = 0;
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Loop condition does not have type Bool.\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "predicate-type")
+             << "Loop condition does not have type Bool.";
     }
 
-    set_type(get_body()->get_type());
+    // A loop evaluates to void, of type Object
+    set_type(Object, classes.typeId(Object));
 
     return success;
 }
 
 // Semantic analysis for a full case statement
 int typcase_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = get_expr()->semant(classes, variables, currentClass);
 
-    Class__class* commonParent = NULL;
+    Symbol commonType = NULL;
+    int commonParent = ClassTable::NO_TYPE_ID;
     for(int i = get_cases()->first(); get_cases()->more(i); i = get_cases()->next(i)) {
         get_cases()->nth(i)->semant(classes, variables, currentClass);
-        if(commonParent == NULL) {
-            commonParent = classes.lookup(get_cases()->nth(i)->get_expr()->get_type()->get_string());
+        Expression branch = get_cases()->nth(i)->get_expr();
+        if(commonType == NULL) {
+            commonType = branch->get_type();
+            commonParent = branch->get_type_id();
         } else {
-            commonParent = classes.nearestCommonParent(commonParent->get_name()->get_string(),
-                            get_cases()->nth(i)->get_expr()->get_type()->get_string());
+            commonParent = classes.join(commonParent, branch->get_type_id());
+            commonType = classes.typeName(commonParent);
         }
     }
 
-    set_type(commonParent->get_name());
+    set_type(commonType, commonParent);
 
     return success;
 }
 
 // Semantic analysis for a block
 int block_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = 1;
 
-    Symbol inferredType = NULL;
+    Expression last = NULL;
     for(int i = get_sbody()->first(); get_sbody()->more(i); i = get_sbody()->next(i)) {
         success = get_sbody()->nth(i)->semant(classes, variables, currentClass) && success;
-        if(!get_sbody()->more(i + 1)) {
-            inferredType = get_sbody()->nth(i)->get_type();
-        }
+        last = get_sbody()->nth(i);
     }
 
-    set_type(inferredType);
+    if(last != NULL) set_type(last->get_type(), last->get_type_id());
 
     return success;
 }
 
 // Semantic analysis for a let expression
 int let_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
     variables.enterscope();
 
-    std::string varName = get_identifier()->get_string();
-    std::string varType = get_type_decl()->get_string();
+    Symbol varType = get_type_decl();
 
-    if(varType == "SELF_TYPE") varType = currentClass->get_name()->get_string();
+    if(varType == SELF_TYPE) varType = currentClass->get_name();
 
     int success = 1;
     if(classes.lookup(varType) == NULL) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Class " << varType << " of let-bound identifier "
-             << varName << " is undefined.\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-let-type")
+             << "Class " << varType << " of let-bound identifier "
+             << get_identifier() << " is undefined.";
         success = 0;
     }
 
-    if(varType == "SELF_TYPE") {
-        char** currentClassName = new char*;
-        *currentClassName = currentClass->get_name()->get_string();
-        variables.addid(get_identifier()->get_string(), currentClassName);
-    } else {
-        char** typeName = new char*;
-        *typeName = get_type_decl()->get_string();
-        variables.addid(get_identifier()->get_string(), typeName);
-    }
-
-    idtable.add_string(get_identifier()->get_string());
+    variables.addid(get_identifier(), get_type_decl());
 
     success = get_init()->semant(classes, variables, currentClass) && success;
 
-    if(success && !classes.inheritsFrom(get_init()->get_type()->get_string(), varType)) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Inferred type " << get_init()->get_type()->get_string()
-             << " of initialization of " << get_identifier()->get_string()
+    Symbol initType = get_init()->get_type();
+    if(success && initType != NULL && !classes.conforms(get_init(), varType)) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "let-type")
+             << "Inferred type " << initType
+             << " of initialization of " << get_identifier()
              << " does not conform to identifier's declared type "
-             << get_type_decl()->get_string() << ".\n";
+             << get_type_decl() << ".";
 
         success = 0;
     }
 
     success = get_body()->semant(classes, variables, currentClass) && success;
 
-    set_type(get_body()->get_type());
+    set_type(get_body()->get_type(), get_body()->get_type_id());
 
     variables.exitscope();
 
     return success;
 }
 
+// Checks that both operands of an arithmetic or comparison operator are Int
+static int checkIntOperands(ClassTable& classes, Class__class* currentClass, tree_node* op,
+                            Expression e1, Expression e2, const char* opName) {
+    if(e1->get_type() != Int || e2->get_type() != Int) {
+        classes.semant_error(currentClass->get_filename(), op->get_line_number(), "arithmetic-type")
+             << "non-Int arguments: " << e1->get_type()
+             << " " << opName << " " << e2->get_type();
+        return 0;
+    }
+
+    return 1;
+}
+
 // Semantic analysis for addition
 int plus_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "+") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " + " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return success;
 }
 
 // Semantic analysis for subtraction
 int sub_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "-") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " - " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return success;
 }
 
 // Semantic analysis for multiplication
 int mul_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "*") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " * " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return success;
 }
 
 // Semantic analysis for division
 int divide_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "/") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " / " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return success;
 }
 
 // Semantic analysis for negation
 int neg_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
 
-    if(std::string(e1->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Argument of '~' has type "
-             << e1->get_type()->get_string() << " instead of Int.\n";
+    if(e1->get_type() != Int) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "arithmetic-type")
+             << "Argument of '~' has type "
+             << e1->get_type() << " instead of Int.";
         success = 0;
     }
 
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return success;
 }
 
 // Semantic analysis for less-than comparison
 int lt_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "<") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " < " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return success;
 }
 
 // Semantic analysis for equality comparison
 int eq_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
 
-    char* type1 = e1->get_type()->get_string();
-    char* type2 = e2->get_type()->get_string();
+    Symbol type1 = e1->get_type();
+    Symbol type2 = e2->get_type();
 
-    if((std::string(type1) == "Int" || std::string(type2) == "Int" ||
-       std::string(type1) == "Bool" || std::string(type2) == "Bool" ||
-       std::string(type1) == "String" || std::string(type2) == "String") &&
-       std::string(type1) != std::string(type2)) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Illegal comparison with a basic type.\n";
+    if((type1 == Int || type2 == Int ||
+       type1 == Bool || type2 == Bool ||
+       type1 == Str || type2 == Str) &&
+       type1 != type2) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "comparison-type")
+             << "Illegal comparison with a basic type.";
         success = 0;
     }
 
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return success;
 }
 
 // Semantic analysis for less-than-or-equal comparison
 int leq_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
     success = e2->semant(classes, variables, currentClass) && success;
+    success = checkIntOperands(classes, currentClass, this, e1, e2, "<=") && success;
 
-    if(std::string(e1->get_type()->get_string()) != "Int" ||
-       std::string(e2->get_type()->get_string()) != "Int") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": non-Int arguments: " << e1->get_type()->get_string()
-             << " <= " << e2->get_type()->get_string()
-             << "\n";
-        success = 0;
-    }
-
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return success;
 }
 
 // Semantic analysis for logical complement
 int comp_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
 
-    if(std::string(e1->get_type()->get_string()) != "Bool") {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Argument of 'not' has type "
-             << e1->get_type()->get_string() << " instead of Bool.\n";
+    if(e1->get_type() != Bool) {
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "not-type")
+             << "Argument of 'not' has type "
+             << e1->get_type() << " instead of Bool.";
         success = 0;
     }
 
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return success;
 }
 
 // Semantic analysis for integer constant
 int int_const_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
-    set_type(idtable.lookup_string("Int"));
+    set_type(Int, classes.typeId(Int));
 
     return 1;
 }
 
 // Semantic analysis for boolean constant
 int bool_const_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return 1;
 }
 
 // Semantic analysis for string constant
 int string_const_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
-    set_type(idtable.lookup_string("String"));
+    set_type(Str, classes.typeId(Str));
 
     return 1;
 }
 
 // Semantic analysis for new keyword
 int new__class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
-    std::string newType = type_name->get_string();
-    if(newType == "SELF_TYPE") newType = currentClass->get_name()->get_string();
+    Symbol newType = type_name;
+    if(newType == SELF_TYPE) newType = currentClass->get_name();
 
     Class__class* thisClass = classes.lookup(newType);
 
     if(thisClass == NULL) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": 'new' used with undefined class "
-             << type_name->get_string() << ".\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undefined-new-class")
+             << "'new' used with undefined class "
+             << type_name << ".";
 
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
         return 0;
     }
 
-    set_type(idtable.lookup_string(thisClass->get_name()->get_string()));
+    set_type(thisClass->get_name(), classes.typeId(newType));
 
     return 1;
 }
 
 // Semantic analysis for isvoid
 int isvoid_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     int success = e1->semant(classes, variables, currentClass);
 
-    set_type(idtable.lookup_string("Bool"));
+    set_type(Bool, classes.typeId(Bool));
 
     return success;
 }
 
 // Semantic analysis for empty expression
 int no_expr_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
     return 1;
 }
 
 // Semantic analysis for object
 int object_class::semant(ClassTable& classes,
-                       SymbolTable<std::string, char*>& variables, Class__class* currentClass) {
+                       VariableTable& variables, Class__class* currentClass) {
 
-    char* thisClass = *variables.lookup(std::string(name->get_string()));
+    Symbol thisClass = identifierType(classes, variables, currentClass, name);
 
     if(thisClass == NULL) {
-        classes.semant_error() << currentClass->get_filename() << ":" << get_line_number()
-             << ": Undeclared identifier "
-             << name->get_string() << ".\n";
+        classes.semant_error(currentClass->get_filename(), get_line_number(), "undeclared-identifier")
+             << "Undeclared identifier "
+             << name << ".";
 
-        set_type(idtable.lookup_string("Object"));
+        set_type(Object, classes.typeId(Object));
         return 0;
     }
 
-    set_type(idtable.lookup_string(thisClass));
+    set_type(thisClass, classes.typeId(thisClass));
 
     return 1;
 }
@@ -1261,20 +2505,23 @@ int object_class::semant(ClassTable& classes,
  */
 void program_class::semant()
 {
-    initialize_constants();
-
     /* ClassTable constructor may do some semantic analysis */
     ClassTable *classtable = new ClassTable(classes);
 
     if (classtable->errors()) {
+        classtable->flushErrors();
+        if (semant_debug) classtable->printStatistics(cerr);
     	cerr << "Compilation halted due to static semantic errors." << endl;
     	exit(1);
     } else {
         // We run the semantic analysis in each class
         classtable->semanticAnalysis();
+        classtable->flushErrors();
+        if (semant_debug) classtable->printStatistics(cerr);
         if (classtable->errors()) {
             cerr << "Compilation halted due to static semantic errors." << endl;
             exit(1);
         }
+        classtable->writeInterfaces();
     }
 }
@@ -0,0 +1,224 @@
+/*
+ * c-runtime.c
+ *
+ * The runtime system for the C code of cgen -C: allocation, boxing,
+ * equality, the runtime errors and the methods of Object, IO and
+ * String, with the messages of the MIPS trap handler.  Build a program
+ * with
+ *
+ *    cc -O2 -I. prog.c c-runtime.c -o prog
+ *
+ * There is no garbage collector; memory is taken from large zeroed
+ * chunks and never given back.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-runtime.h"
+
+#define CHUNK_SIZE (1024 * 1024)
+
+static char *chunk;
+static size_t chunk_left;
+
+static COOL_NORETURN void cool_exit(int status)
+{
+  fflush(stdout);
+  exit(status);
+}
+
+/* Zeroed memory, aligned for any field of an object */
+void *cool_alloc(size_t size)
+{
+  size = (size + 7) & ~(size_t) 7;
+  if (size > chunk_left)
+    {
+      size_t n = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+      chunk = calloc(1, n);
+      if (chunk == NULL)
+	{
+	  fprintf(stderr, "out of memory\n");
+	  cool_exit(1);
+	}
+      chunk_left = n;
+    }
+  void *p = chunk;
+  chunk += size;
+  chunk_left -= size;
+  return p;
+}
+
+obj cool_box_int(int32_t val)
+{
+  struct Int *i = cool_alloc(sizeof(struct Int));
+  i->parent.cls = cool_int_class;
+  i->val = val;
+  return (obj) i;
+}
+
+obj cool_box_bool(int32_t val)
+{
+  struct Bool *b = cool_alloc(sizeof(struct Bool));
+  b->parent.cls = cool_bool_class;
+  b->val = val;
+  return (obj) b;
+}
+
+static obj new_string(const char *chars, int32_t len)
+{
+  struct String *s = cool_alloc(sizeof(struct String));
+  char *copy = cool_alloc(len + 1);
+  memcpy(copy, chars, len);
+  s->parent.cls = cool_string_class;
+  s->len = len;
+  s->chars = copy;
+  return (obj) s;
+}
+
+static struct String *string(obj o) { return (struct String *) o; }
+
+static void print_string(obj o)
+{
+  fwrite(string(o)->chars, 1, string(o)->len, stdout);
+}
+
+/* = on objects: identity, or equal values for Int, Bool and String */
+int cool_equal(obj a, obj b)
+{
+  if (a == b)
+    return 1;
+  if (a == NULL || b == NULL || a->cls != b->cls)
+    return 0;
+  if (a->cls == cool_int_class || a->cls == cool_bool_class)
+    return cool_unbox(a) == cool_unbox(b);
+  if (a->cls == cool_string_class)
+    return string(a)->len == string(b)->len &&
+      memcmp(string(a)->chars, string(b)->chars, string(a)->len) == 0;
+  return 0;
+}
+
+void cool_dispatch_abort(const char *filename, int line)
+{
+  printf("%s:%d: Dispatch to void.\n", filename, line);
+  cool_exit(1);
+}
+
+void cool_case_abort(obj o)
+{
+  printf("No match in case statement for Class ");
+  print_string(o->cls->name);
+  printf("\n");
+  cool_exit(1);
+}
+
+void cool_case_abort2(const char *filename, int line)
+{
+  printf("%s:%d: Match on void in case statement.\n", filename, line);
+  cool_exit(1);
+}
+
+void cool_division_by_zero(void)
+{
+  printf("Exception: division by zero\n");
+  cool_exit(1);
+}
+
+obj Object__abort(obj self)
+{
+  printf("Abort called from class ");
+  print_string(self->cls->name);
+  printf("\n");
+  cool_exit(0);
+}
+
+obj Object__type_name(obj self) { return self->cls->name; }
+
+obj Object__copy(obj self)
+{
+  obj copy = cool_alloc(self->cls->size);
+  memcpy(copy, self, self->cls->size);
+  return copy;
+}
+
+obj IO__out_string(obj self, obj x)
+{
+  print_string(x);
+  return self;
+}
+
+obj IO__out_int(obj self, int32_t x)
+{
+  printf("%d", x);
+  return self;
+}
+
+/* Reads a line without its newline; the caller frees it */
+static char *read_line(size_t *n)
+{
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, stdin);
+  if (len < 0)
+    len = 0;
+  if (len > 0 && line[len - 1] == '\n')
+    line[--len] = '\0';
+  *n = len;
+  return line;
+}
+
+obj IO__in_string(obj self)
+{
+  size_t n;
+  char *line = read_line(&n);
+  obj s = new_string(line ? line : "", n);
+  free(line);
+  return s;
+}
+
+int32_t IO__in_int(obj self)
+{
+  size_t n;
+  char *line = read_line(&n), *end;
+  long long v = 0;
+  if (line)
+    {
+      char *start = line + strspn(line, " \t\r");
+      v = strtoll(start, &end, 10);
+      if (end == start || (*end && !strchr(" \t\r", *end)))
+	v = 0;
+    }
+  free(line);
+  return (int32_t) v;
+}
+
+int32_t String__length(obj self) { return string(self)->len; }
+
+obj String__concat(obj self, obj s)
+{
+  int32_t la = string(self)->len, lb = string(s)->len;
+  char *chars = malloc(la + lb + 1);
+  memcpy(chars, string(self)->chars, la);
+  memcpy(chars + la, string(s)->chars, lb);
+  obj r = new_string(chars, la + lb);
+  free(chars);
+  return r;
+}
+
+obj String__substr(obj self, int32_t i, int32_t l)
+{
+  if (i < 0 || l < 0 || (int64_t) i + l > string(self)->len)
+    {
+      printf("Index to substr is out of range\n");
+      cool_exit(1);
+    }
+  return new_string(string(self)->chars + i, l);
+}
+
+int main(void)
+{
+  cool_main();
+  printf("COOL program successfully executed\n");
+  cool_exit(0);
+}
@@ -0,0 +1,83 @@
+/*
+ * c-runtime.h
+ *
+ * The interface between the C written by cgen -C and its runtime
+ * system, c-runtime.c.
+ *
+ * Every object starts with a pointer to the descriptor of its class.
+ * The struct of a class holds the one of its parent as its first
+ * member, followed by its own attributes, and its dispatch table
+ * extends the one of the parent in the same way, starting with the
+ * struct cool_class descriptor.  Int and Bool values are plain
+ * int32_t; they are boxed in struct Int and struct Bool only where
+ * they are used as objects.
+ */
+
+#ifndef C_RUNTIME_H
+#define C_RUNTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define COOL_NORETURN __attribute__((noreturn))
+#else
+#define COOL_NORETURN
+#endif
+
+typedef struct Object *obj;
+
+struct cool_class {
+  int32_t tag;                   /* preorder number in the class tree */
+  obj name;                      /* a String */
+  size_t size;                   /* of the objects, for copy() */
+  obj (*make)(void);             /* new, for new SELF_TYPE */
+};
+
+struct Object { const struct cool_class *cls; };
+struct IO     { struct Object parent; };
+struct Int    { struct Object parent; int32_t val; };
+struct Bool   { struct Object parent; int32_t val; };
+struct String { struct Object parent; int32_t len; const char *chars; };
+
+/* Defined by the generated code */
+extern const struct cool_class *const cool_int_class;
+extern const struct cool_class *const cool_bool_class;
+extern const struct cool_class *const cool_string_class;
+void cool_main(void);
+
+void *cool_alloc(size_t size);
+obj cool_box_int(int32_t val);
+obj cool_box_bool(int32_t val);
+int cool_equal(obj a, obj b);
+
+static inline int32_t cool_unbox(obj o) { return ((struct Int *) o)->val; }
+
+COOL_NORETURN void cool_dispatch_abort(const char *filename, int line);
+COOL_NORETURN void cool_case_abort(obj o);
+COOL_NORETURN void cool_case_abort2(const char *filename, int line);
+COOL_NORETURN void cool_division_by_zero(void);
+
+/* Division as on MIPS: INT32_MIN / -1 wraps around */
+static inline int32_t cool_div(int32_t a, int32_t b)
+{
+  if (b == 0)
+    cool_division_by_zero();
+  if (b == -1)
+    return (int32_t) (0u - (uint32_t) a);
+  return a / b;
+}
+
+/* The methods of the basic classes */
+obj Object__abort(obj self);
+obj Object__type_name(obj self);
+obj Object__copy(obj self);
+obj IO__out_string(obj self, obj x);
+obj IO__out_int(obj self, int32_t x);
+obj IO__in_string(obj self);
+int32_t IO__in_int(obj self);
+int32_t String__length(obj self);
+obj String__concat(obj self, obj s);
+obj String__substr(obj self, int32_t i, int32_t l);
+
+#endif
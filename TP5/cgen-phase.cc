@@ -7,6 +7,7 @@
 
 extern int optind;            // for option processing
 extern char *out_filename;    // name of output assembly
+extern int cgen_emit_c;       // the output is C
 extern Program ast_root;             // root of the abstract syntax tree
 FILE *ast_file = stdin;       // we read the AST from standard input
 extern int ast_yyparse(void); // entry point to the AST parser
@@ -29,7 +30,7 @@ int main(int argc, char *argv[]) {
       if (dot) *dot = '\0'; // strip off file extension
       out_filename = new char[strlen(argv[optind])+8];
       strcpy(out_filename, argv[optind]);
-      strcat(out_filename, ".s");
+      strcat(out_filename, cgen_emit_c ? ".c" : ".s");
   }
 
   // 
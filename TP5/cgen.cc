@@ -22,11 +22,17 @@
 //
 //**************************************************************
 
+#include <stdlib.h>
+#include <string.h>
 #include "cgen.h"
 #include "cgen_gc.h"
 
 extern void emit_string_constant(ostream& str, char *s);
 extern int cgen_debug;
+extern int cgen_optimize;
+extern int cgen_native;
+extern int cgen_emit_c;
+extern bool disable_reg_alloc;
 
 //
 // Three symbols from the semantic analyzer (semant.cc) are used.
@@ -75,6 +81,10 @@ Symbol
 //
 static void initialize_constants(void)
 {
+  // The names never change, so they are only interned once per process
+  if (arg != NULL)
+    return;
+
   arg         = idtable.add_string("arg");
   arg2        = idtable.add_string("arg2");
   Bool        = idtable.add_string("Bool");
@@ -116,6 +126,24 @@ static char *gc_collect_names[] =
 BoolConst falsebool(FALSE);
 BoolConst truebool(TRUE);
 
+//
+// Values of static type Int and Bool are kept unboxed: the number, or
+// 0 and 1, in registers, temporaries, attributes, arguments and
+// results declared Int or Bool.  They are boxed only where they flow
+// into a location that holds objects: variables, attributes, formals
+// and results of other types, and case expressions.  The methods of
+// the basic classes, and those redefining them, keep objects in their
+// formals and results, since the runtime system codes them.  The
+// generational collector would take raw values on the stack for
+// pointers, so with it every value is an object.
+//
+static int unboxing = FALSE;
+
+static int unboxed(Symbol type)
+{
+  return unboxing && (type == Int || type == Bool);
+}
+
 //*********************************************************
 //
 // Define method for code generation
@@ -131,13 +159,30 @@ BoolConst truebool(TRUE);
 
 void program_class::cgen(ostream &os) 
 {
+  initialize_constants();
+  if (cgen_optimize)
+    fold_constants(classes);
+
+  // The C backend writes a whole translation unit (see cgen_c.cc)
+  if (cgen_emit_c) {
+    new CgenClassTable(classes,os);
+    return;
+  }
+
+  // With -n the code goes through the x86 lowering, whose runtime has
+  // no garbage collector (see x86.cc)
+  X86Lowering lowering(os);
+  ostream s(cgen_native ? &lowering : os.rdbuf());
+  if (cgen_native)
+    cgen_Memmgr = GC_NOGC;
+
   // spim wants comments to start with '#'
-  os << "# start of generated code\n";
+  s << "# start of generated code\n";
 
-  initialize_constants();
-  CgenClassTable *codegen_classtable = new CgenClassTable(classes,os);
+  CgenClassTable *codegen_classtable = new CgenClassTable(classes,s);
 
-  os << "\n# end of generated code\n";
+  s << "\n# end of generated code\n";
+  s.flush();
 }
 
 
@@ -227,6 +272,9 @@ static void emit_sll(char *dest, char *src1, int num, ostream& s)
 static void emit_jalr(char *dest, ostream& s)
 { s << JALR << "\t" << dest << endl; }
 
+static void emit_jr(char *dest, ostream& s)
+{ s << JR << dest << endl; }
+
 static void emit_jal(char *address,ostream &s)
 { s << JAL << address << endl; }
 
@@ -264,6 +312,13 @@ static void emit_beqz(char *source, int label, ostream &s)
   s << endl;
 }
 
+static void emit_bnez(char *source, int label, ostream &s)
+{
+  s << BNE << source << " " << ZERO << " ";
+  emit_label_ref(label,s);
+  s << endl;
+}
+
 static void emit_beq(char *src1, char *src2, int label, ostream &s)
 {
   s << BEQ << src1 << " " << src2 << " ";
@@ -612,20 +667,120 @@ void CgenClassTable::code_constants()
 
 CgenClassTable::CgenClassTable(Classes classes, ostream& s) : nds(NULL) , str(s)
 {
-   stringclasstag = 4;
-   intclasstag =    2;
-   boolclasstag =   3; // We try to follow to coolc convention
-
    enterscope();
    if (cgen_debug) cout << "Building CgenClassTable" << endl;
    install_basic_classes();
    install_classes(classes);
    build_inheritance_tree();
 
-   code();
+   root()->number(0, classes_by_tag);
+   stringclasstag = probe(Str)->get_tag();
+   intclasstag    = probe(Int)->get_tag();
+   boolclasstag   = probe(Bool)->get_tag();
+   root()->layout();
+   if (cgen_optimize)
+     Receivers(this).run();
+
+   if (cgen_emit_c)
+     code_c();
+   else
+     code();
    exitscope();
 }
 
+//
+// The basic classes, one row per feature, in class order:
+//
+//   Object:  abort() : Object, type_name() : Str, copy() : SELF_TYPE
+//   IO:      out_string(Str), out_int(Int) : SELF_TYPE,
+//            in_string() : Str, in_int() : Int
+//   Int:     the "val" slot
+//   Bool:    the "val" slot
+//   Str:     val (the length), str_field (the string itself),
+//            length() : Int, concat(arg: Str) : Str,
+//            substr(arg: Int, arg2: Int) : Str
+//
+// There is no need for method bodies in the basic classes---these
+// are already built in to the runtime system.  Methods take up to two
+// formals, called arg and arg2.
+//
+static Symbol *const basic_class_names[][2] = {
+  { &Object, &No_class },
+  { &IO,     &Object   },
+  { &Int,    &Object   },
+  { &Bool,   &Object   },
+  { &Str,    &Object   },
+};
+
+struct BasicFeature {
+  Symbol *owner;
+  int is_method;
+  Symbol *name;
+  Symbol *type;
+  Symbol *formal_types[2];
+};
+
+static const BasicFeature basic_features[] = {
+  { &Object, 1, &cool_abort, &Object,    { NULL, NULL } },
+  { &Object, 1, &type_name,  &Str,       { NULL, NULL } },
+  { &Object, 1, &copy,       &SELF_TYPE, { NULL, NULL } },
+  { &IO,     1, &out_string, &SELF_TYPE, { &Str, NULL } },
+  { &IO,     1, &out_int,    &SELF_TYPE, { &Int, NULL } },
+  { &IO,     1, &in_string,  &Str,       { NULL, NULL } },
+  { &IO,     1, &in_int,     &Int,       { NULL, NULL } },
+  { &Int,    0, &val,        &prim_slot, { NULL, NULL } },
+  { &Bool,   0, &val,        &prim_slot, { NULL, NULL } },
+  { &Str,    0, &val,        &Int,       { NULL, NULL } },
+  { &Str,    0, &str_field,  &prim_slot, { NULL, NULL } },
+  { &Str,    1, &length,     &Int,       { NULL, NULL } },
+  { &Str,    1, &concat,     &Str,       { &Str, NULL } },
+  { &Str,    1, &substr,     &Str,       { &Int, &Int } },
+};
+
+//
+// The trees of the basic classes never change, so they are built once
+// per process and shared by every class table.
+//
+static Classes basic_classes(Symbol filename)
+{
+  static Classes classes = NULL;
+  if (classes != NULL)
+    return classes;
+
+  Symbol *formal_names[] = { &arg, &arg2 };
+  int nfeatures = sizeof(basic_features) / sizeof(basic_features[0]);
+  int nclasses = sizeof(basic_class_names) / sizeof(basic_class_names[0]);
+
+  classes = nil_Classes();
+  for (int i = 0; i < nclasses; i++)
+    {
+      Features features = nil_Features();
+      for (int j = 0; j < nfeatures; j++)
+	{
+	  const BasicFeature &f = basic_features[j];
+	  if (f.owner != basic_class_names[i][0])
+	    continue;
+
+	  Feature feature;
+	  if (f.is_method)
+	    {
+	      Formals formals = nil_Formals();
+	      for (int k = 0; k < 2 && f.formal_types[k] != NULL; k++)
+		formals = append_Formals(formals,
+			    single_Formals(formal(*formal_names[k], *f.formal_types[k])));
+	      feature = method(*f.name, formals, *f.type, no_expr());
+	    }
+	  else
+	    feature = attr(*f.name, *f.type, no_expr());
+	  features = append_Features(features, single_Features(feature));
+	}
+      classes = append_Classes(classes,
+		  single_Classes(class_(*basic_class_names[i][0], *basic_class_names[i][1],
+					features, filename)));
+    }
+  return classes;
+}
+
 void CgenClassTable::install_basic_classes()
 {
 
@@ -652,100 +807,12 @@ void CgenClassTable::install_basic_classes()
 			    Basic,this));
 
 // 
-// The Object class has no parent class. Its methods are
-//        cool_abort() : Object    aborts the program
-//        type_name() : Str        returns a string representation of class name
-//        copy() : SELF_TYPE       returns a copy of the object
+// The Object, IO, Int, Bool and String classes come from the prelude,
+// built the first time a table needs it.
 //
-// There is no need for method bodies in the basic classes---these
-// are already built in to the runtime system.
-//
-  install_class(
-   new CgenNode(
-    class_(Object, 
-	   No_class,
-	   append_Features(
-           append_Features(
-           single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
-           single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
-           single_Features(method(copy, nil_Formals(), SELF_TYPE, no_expr()))),
-	   filename),
-    Basic,this));
-
-// 
-// The IO class inherits from Object. Its methods are
-//        out_string(Str) : SELF_TYPE          writes a string to the output
-//        out_int(Int) : SELF_TYPE               "    an int    "  "     "
-//        in_string() : Str                    reads a string from the input
-//        in_int() : Int                         "   an int     "  "     "
-//
-   install_class(
-    new CgenNode(
-     class_(IO, 
-            Object,
-            append_Features(
-            append_Features(
-            append_Features(
-            single_Features(method(out_string, single_Formals(formal(arg, Str)),
-                        SELF_TYPE, no_expr())),
-            single_Features(method(out_int, single_Formals(formal(arg, Int)),
-                        SELF_TYPE, no_expr()))),
-            single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
-            single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
-	   filename),	    
-    Basic,this));
-
-//
-// The Int class has no methods and only a single attribute, the
-// "val" for the integer. 
-//
-   install_class(
-    new CgenNode(
-     class_(Int, 
-	    Object,
-            single_Features(attr(val, prim_slot, no_expr())),
-	    filename),
-     Basic,this));
-
-//
-// Bool also has only the "val" slot.
-//
-    install_class(
-     new CgenNode(
-      class_(Bool, Object, single_Features(attr(val, prim_slot, no_expr())),filename),
-      Basic,this));
-
-//
-// The class Str has a number of slots and operations:
-//       val                                  ???
-//       str_field                            the string itself
-//       length() : Int                       length of the string
-//       concat(arg: Str) : Str               string concatenation
-//       substr(arg: Int, arg2: Int): Str     substring
-//       
-   install_class(
-    new CgenNode(
-      class_(Str, 
-	     Object,
-             append_Features(
-             append_Features(
-             append_Features(
-             append_Features(
-             single_Features(attr(val, Int, no_expr())),
-            single_Features(attr(str_field, prim_slot, no_expr()))),
-            single_Features(method(length, nil_Formals(), Int, no_expr()))),
-            single_Features(method(concat, 
-				   single_Formals(formal(arg, Str)),
-				   Str, 
-				   no_expr()))),
-	    single_Features(method(substr, 
-				   append_Formals(single_Formals(formal(arg, Int)), 
-						  single_Formals(formal(arg2, Int))),
-				   Str, 
-				   no_expr()))),
-	     filename),
-        Basic,this));
-
+  Classes basic = basic_classes(filename);
+  for(int i = basic->first(); basic->more(i); i = basic->next(i))
+    install_class(new CgenNode(basic->nth(i),Basic,this));
 }
 
 // CgenClassTable::install_class
@@ -808,82 +875,250 @@ void CgenNode::set_parentnd(CgenNodeP p)
   parentnd = p;
 }
 
-// Custom CgenNode function for dispatch table content
-void CgenNode::emit_dispatch_table(ostream& s) {
-  if(parentnd != NULL) parentnd->emit_dispatch_table(s);
+//
+// CgenNode::number
+//
+// Class tags are given in preorder over the inheritance tree, so the
+// classes below a class have the tags between its own and `max_tag'.
+// The nodes are also collected in tag order, which is the order of
+// class_nameTab and class_objTab.
+//
+int CgenNode::number(int next, std::vector<CgenNodeP>& by_tag)
+{
+  tag = next++;
+  by_tag.push_back(this);
+  for(List<CgenNode> *l = children; l; l = l->tl())
+    next = l->hd()->number(next, by_tag);
+  max_tag = next - 1;
+  return next;
+}
+
+//
+// The objects and the dispatch table of a class extend the ones of its
+// parent, so both layouts are computed once, from the root down.  The
+// attributes of the class follow the inherited ones.  A method the
+// class redefines takes over the slot of the inherited one, so a slot
+// means the same method in every subclass; new methods are appended.
+//
+void CgenNode::layout()
+{
+  if (parentnd != NULL) {
+    attributes = parentnd->attributes;
+    method_names = parentnd->method_names;
+    method_owners = parentnd->method_owners;
+    method_slots = parentnd->method_slots;
+  }
 
   for(int i = features->first(); features->more(i); i = features->next(i)) {
     Feature f = features->nth(i);
-    if(f->isMethod()) {
-      s << WORD;
-      emit_method_ref(name, f->getName(), s);
-      s << "\n";
+    if(!f->isMethod()) {
+      attributes.push_back((attr_class *) f);
+      continue;
+    }
+
+    std::map<Symbol,int>::iterator slot = method_slots.find(f->getName());
+    if(slot != method_slots.end())
+      method_owners[slot->second] = name;
+    else {
+      method_slots[f->getName()] = method_names.size();
+      method_names.push_back(f->getName());
+      method_owners.push_back(name);
     }
   }
+
+  for(List<CgenNode> *l = children; l; l = l->tl())
+    l->hd()->layout();
 }
 
+// Word offset of an attribute within the objects of the class
+int CgenNode::attribute_offset(Symbol attr)
+{
+  for(int i = attributes.size() - 1; i >= 0; i--)
+    if(attributes[i]->name == attr)
+      return DEFAULT_OBJFIELDS + i;
+  assert(0);
+  return -1;
+}
 
+// Whether an attribute holds a raw Int or Bool; those of the basic
+// classes are read by the runtime system
+int CgenNode::unboxed_attribute(Symbol attr)
+{
+  return !basic() && unboxed(attributes[attribute_offset(attr) - DEFAULT_OBJFIELDS]->type_decl);
+}
 
-void CgenClassTable::code()
+// Slot of a method in the dispatch table of the class
+int CgenNode::method_offset(Symbol meth)
 {
-  if (cgen_debug) cout << "coding global data" << endl;
-  code_global_data();
+  std::map<Symbol,int>::iterator slot = method_slots.find(meth);
+  assert(slot != method_slots.end());
+  return slot->second;
+}
 
-  if (cgen_debug) cout << "choosing gc" << endl;
-  code_select_gc();
+//
+// Whether the Int and Bool formals and result of a method are raw:
+// not when the slot comes from a basic class, whose methods are coded
+// in the runtime system.
+//
+int CgenNode::unboxed_method(Symbol meth)
+{
+  CgenNodeP nd = this;
+  while(nd->parentnd != NULL && nd->parentnd->method_slots.count(meth))
+    nd = nd->parentnd;
+  return !nd->basic();
+}
 
-  if (cgen_debug) cout << "coding constants" << endl;
-  code_constants();
+//
+// The class whose method `meth' runs for every object of this class
+// and of its subclasses, or NULL when a subclass overrides it.
+//
+Symbol CgenNode::dispatch_target(Symbol meth)
+{
+  Symbol owner = method_owner(meth);
+  for(List<CgenNode> *l = children; l; l = l->tl())
+    if(l->hd()->dispatch_target(meth) != owner)
+      return NULL;
+  return owner;
+}
 
-  // Populate class_nameTab
-  List<CgenNode>* temp = nds;
+//
+// The class whose method `meth' runs for every object a dispatch on a
+// receiver of class `nd' may be made on: the objects of the receiver
+// classes the analysis of -O found, or of `nd' and its subclasses when
+// it found none.  NULL when they run different methods.
+//
+Symbol CgenClassTable::dispatch_target(CgenNodeP nd, Symbol meth, std::vector<int>& receivers)
+{
+  if(receivers.empty())
+    return nd->dispatch_target(meth);
+  Symbol owner = classes_by_tag[receivers[0]]->method_owner(meth);
+  for(unsigned i = 1; i < receivers.size(); i++)
+    if(classes_by_tag[receivers[i]]->method_owner(meth) != owner)
+      return NULL;
+  return owner;
+}
+
+// Custom CgenNode function for dispatch table content
+void CgenNode::emit_dispatch_table(ostream& s) {
+  for(unsigned i = 0; i < method_names.size(); i++) {
+    s << WORD;
+    emit_method_ref(method_owners[i], method_names[i], s);
+    s << "\n";
+  }
+}
+
+//
+// The prototype object of a class holds the default value of every
+// attribute: the constants 0, "" and false for the basic types, void
+// for anything else.
+//
+void CgenNode::code_protobj(ostream& s)
+{
+  // Add -1 eye catcher
+  s << WORD << "-1" << endl;
+
+  emit_protobj_ref(name, s);  s << LABEL
+    << WORD << tag << endl
+    << WORD << (DEFAULT_OBJFIELDS + attributes.size()) << endl
+    << WORD;  emit_disptable_ref(name, s);  s << endl;
+
+  for(unsigned i = 0; i < attributes.size(); i++) {
+    Symbol type = attributes[i]->type_decl;
+    s << WORD;
+    if(unboxed_attribute(attributes[i]->name))
+      s << 0;
+    else if(type == Int)
+      inttable.lookup_string("0")->code_ref(s);
+    else if(type == Str)
+      stringtable.lookup_string("")->code_ref(s);
+    else if(type == Bool)
+      falsebool.code_ref(s);
+    else
+      s << EMPTYSLOT;
+    s << endl;
+  }
+}
+
+//
+// class_nameTab and class_objTab are indexed by class tag, and so are
+// the dispatch tables emitted after them.
+//
+void CgenClassTable::code_class_tables()
+{
   str << CLASSNAMETAB << LABEL;
-  for (CgenNodeP n = temp->hd(); list_length(temp) > 1; temp = temp->tl(), n = temp->hd()) {
+  for(unsigned i = 0; i < classes_by_tag.size(); i++) {
     str << WORD;
-    stringtable.lookup_string(n->name->get_string())->code_ref(str);
-    str << "\n";
+    stringtable.lookup_string(classes_by_tag[i]->name->get_string())->code_ref(str);
+    str << endl;
   }
-  // Add Object class as well
-  str << WORD;
-  stringtable.lookup_string(root()->name->get_string())->code_ref(str);
-  str << "\n";
 
-  // Now we populate the objTab
-  temp = nds;
   str << CLASSOBJTAB << LABEL;
-  for (CgenNodeP n = temp->hd(); list_length(temp) > 1; temp = temp->tl(), n = temp->hd()) {
-    str << WORD << n->name->get_string() << PROTOBJ_SUFFIX << "\n";
-    str << WORD << n->name->get_string() << CLASSINIT_SUFFIX << "\n";
+  for(unsigned i = 0; i < classes_by_tag.size(); i++) {
+    str << WORD;  emit_protobj_ref(classes_by_tag[i]->name, str);  str << endl;
+    str << WORD;  emit_init_ref(classes_by_tag[i]->name, str);  str << endl;
   }
-  // Add Object class as well
-  str << WORD << root()->name->get_string() << PROTOBJ_SUFFIX << "\n";
-  str << WORD << root()->name->get_string() << CLASSINIT_SUFFIX << "\n";
 
-  // Emit dispatch table for classes
-  temp = nds;
-  str << root()->name->get_string() << DISPTAB_SUFFIX << LABEL;
-  root()->emit_dispatch_table(str);
-  for (CgenNodeP n = temp->hd(); list_length(temp) > 1; temp = temp->tl(), n = temp->hd()) {
-    str << n->name->get_string() << DISPTAB_SUFFIX << LABEL;
-    n->emit_dispatch_table(str);
+  for(unsigned i = 0; i < classes_by_tag.size(); i++) {
+    emit_disptable_ref(classes_by_tag[i]->name, str);  str << LABEL;
+    classes_by_tag[i]->emit_dispatch_table(str);
   }
+}
 
-  // Emit prototype objects for each class
+void CgenClassTable::code_prototypes()
+{
+  for(unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_protobj(str);
+}
 
-//                 Add your code to emit
-//                   - prototype objects
-//                   - class_nameTab (DONE)
-//                   - dispatch tables (DONE)
 //
+// Every class gets an initializer; only the classes of the program
+// get method code, the basic ones are in the runtime system.
+//
+void CgenClassTable::code_methods()
+{
+  for(unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_init(str);
+
+  for(unsigned i = 0; i < classes_by_tag.size(); i++) {
+    CgenNodeP nd = classes_by_tag[i];
+    if(nd->basic())
+      continue;
+
+    Features fs = nd->features;
+    for(int i = fs->first(); fs->more(i); i = fs->next(i))
+      if(fs->nth(i)->isMethod())
+        nd->code_method((method_class *) fs->nth(i), str);
+  }
+}
+
+void CgenClassTable::code()
+{
+  unboxing = cgen_Memmgr == GC_NOGC;
+
+  if (cgen_debug) cout << "coding global data" << endl;
+  code_global_data();
+
+  if (cgen_debug) cout << "choosing gc" << endl;
+  code_select_gc();
+
+  if (cgen_debug) cout << "coding constants" << endl;
+  code_constants();
+
+  if (cgen_debug) cout << "coding class tables" << endl;
+  code_class_tables();
+
+  // Emit prototype objects for each class
+  if (cgen_debug) cout << "coding prototype objects" << endl;
+  code_prototypes();
 
   if (cgen_debug) cout << "coding global text" << endl;
   code_global_text();
 
-//                 Add your code to emit
-//                   - object initializer
-//                   - the class methods
-//                   - etc...
+  if (cgen_debug) cout << "coding initializers and methods" << endl;
+  code_methods();
 
+  if (cgen_optimize)
+    print_peephole_stats(str);
 }
 
 
@@ -903,9 +1138,529 @@ CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
    class__class((const class__class &) *nd),
    parentnd(NULL),
    children(NULL),
-   basic_status(bstatus)
+   basic_status(bstatus),
+   class_table(ct),
+   tag(-1),
+   max_tag(-1)
 { 
    stringtable.add_string(name->get_string());          // Add class name to string table
+   stringtable.add_string(filename->get_string());      // For the runtime error messages
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// Routines: frames, names in scope and temporaries
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// Registers for temporaries.  Values that are live across a call must
+// sit in a callee-saved register, which the routine saves in its frame;
+// the others may also use the caller-saved ones.  $t1-$t3, $a0 and $a1
+// stay free for the code of the expressions themselves.
+//
+static char *caller_saved[] = { "$t4", "$t5", "$t6", "$t7", "$t8", "$t9" };
+static char *callee_saved[] = { "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7" };
+#define NCALLER ((int) (sizeof(caller_saved) / sizeof(caller_saved[0])))
+#define NCALLEE ((int) (sizeof(callee_saved) / sizeof(callee_saved[0])))
+
+static int label_count = 0;
+
+// Output of the pass that only measures the live ranges
+static ostream nowhere(NULL);
+
+// Loads the Bool result of a test
+static void emit_load_truth(char *dest, int val, ostream& s)
+{
+  if(unboxing)
+    emit_load_imm(dest, val, s);
+  else
+    emit_load_bool(dest, val ? truebool : falsebool, s);
+}
+
+//
+// Boxes the raw value in $a0.  Bools are one of the two constants; an
+// Int gets a fresh object.
+//
+static void emit_box(Symbol type, CgenContext& ctx, ostream& s)
+{
+  if(type == Bool) {
+    int done = label_count++;
+    emit_move(T1, ACC, s);
+    emit_load_bool(ACC, truebool, s);
+    emit_bnez(T1, done, s);
+    emit_load_bool(ACC, falsebool, s);
+    emit_label_def(done, s);
+    return;
+  }
+
+  int t = ctx.save(ACC, s);
+  emit_partial_load_address(ACC, s);  emit_protobj_ref(Int, s);  s << endl;
+  emit_jal("Object.copy", s);
+  ctx.call();
+  char *r = ctx.load(t, T1, s);
+  emit_store_int(r, ACC, s);
+  ctx.release(t, s);
+}
+
+// A value of static type `from' in $a0, used as one of type `to'
+static void emit_convert(Symbol from, Symbol to, CgenContext& ctx, ostream& s)
+{
+  if(unboxed(from) && !unboxed(to))
+    emit_box(from, ctx, s);
+  else if(!unboxed(from) && unboxed(to))
+    emit_fetch_int(ACC, ACC, s);
+}
+
+//
+// Codes `e' for a location holding objects.  Constants are taken
+// boxed from the constant table.
+//
+static void code_boxed(Expression e, CgenContext& ctx, ostream& s)
+{
+  if(unboxed(e->get_type()) && e->is_const()) {
+    if(e->get_type() == Int)
+      emit_load_int(ACC, inttable.lookup_string(((int_const_class *) e)->token->get_string()), s);
+    else
+      emit_load_bool(ACC, BoolConst(((bool_const_class *) e)->val), s);
+    return;
+  }
+  e->code(s, ctx);
+  emit_convert(e->get_type(), Object, ctx, s);
+}
+
+// Codes `e' for a location of static type `type'
+static void code_as(Expression e, Symbol type, CgenContext& ctx, ostream& s)
+{
+  if(unboxed(type))
+    e->code(s, ctx);
+  else
+    code_boxed(e, ctx, s);
+}
+
+//
+// The layout of a frame, from $fp up:
+//
+//    spilled temporaries           nslots words
+//    saved callee-saved registers  one word each
+//    return address, self, old $fp
+//    arguments, the last one first
+//
+// Temporaries on the stack (when there is no register allocation) are
+// pushed below $fp.
+//
+CgenContext::CgenContext(CgenClassTableP t, CgenNodeP c, method_class *m) :
+  table(t), cls(c), next_temp(0), events(0), last_call(-1), depth(0),
+  nformals(0), nslots(0), recording(0)
+{
+  // The generational collector only scans the stack for pointers, so
+  // they must not be kept in registers when it is on.
+  allocating = !disable_reg_alloc && cgen_Memmgr == GC_NOGC;
+
+  vars.enterscope();
+  if(m != NULL) {
+    Formals formals = m->formals;
+    int raw = c->unboxed_method(m->name);
+    nformals = formals->len();
+    for(int i = formals->first(); formals->more(i); i = formals->next(i)) {
+      formal_class *f = (formal_class *) formals->nth(i);
+      Binding *b = new Binding;
+      b->kind = Binding::Formal;
+      b->index = i;
+      b->unboxed = raw && unboxed(f->type_decl);
+      vars.addid(f->name, b);
+    }
+  }
+}
+
+Location CgenContext::formal_location(int index)
+{
+  Location l;
+  l.reg = FP;
+  l.offset = frame_words() + nformals - 1 - index;
+  l.in_register = FALSE;
+  return l;
+}
+
+//
+// Start coding the body.  The recording pass numbers the events from
+// scratch; the pass that emits code finds the temporaries in the same
+// order and uses the locations the allocator gave them.
+//
+void CgenContext::begin_pass(int record)
+{
+  recording = record;
+  next_temp = 0;
+  events = 0;
+  last_call = -1;
+  depth = 0;
+}
+
+void CgenContext::bind(Symbol name, int temp, Symbol type)
+{
+  Binding *b = new Binding;
+  b->kind = Binding::Temporary;
+  b->index = temp;
+  b->unboxed = unboxed(type);
+  vars.addid(name, b);
+}
+
+int CgenContext::holds_unboxed(Symbol name)
+{
+  Binding *b = vars.lookup(name);
+  if(b == NULL)
+    return cls->unboxed_attribute(name);
+  return b->unboxed;
+}
+
+void CgenContext::load_var(char *dest, Symbol name, ostream& s)
+{
+  Binding *b = vars.lookup(name);
+  if(b == NULL)
+    emit_load(dest, cls->attribute_offset(name), SELF, s);
+  else if(b->kind == Binding::Formal) {
+    Location l = formal_location(b->index);
+    emit_load(dest, l.offset, l.reg, s);
+  }
+  else {
+    char *r = load(b->index, dest, s);
+    if(r != dest)
+      emit_move(dest, r, s);
+  }
+}
+
+void CgenContext::store_var(Symbol name, char *source, ostream& s)
+{
+  Binding *b = vars.lookup(name);
+  if(b == NULL) {
+    int offset = cls->attribute_offset(name);
+    emit_store(source, offset, SELF, s);
+    if(cgen_Memmgr == GC_GENGC) {
+      emit_addiu(A1, SELF, offset * WORD_SIZE, s);
+      emit_gc_assign(s);
+      call();
+    }
+  }
+  else if(b->kind == Binding::Formal) {
+    Location l = formal_location(b->index);
+    emit_store(source, l.offset, l.reg, s);
+  }
+  else
+    store(b->index, source, s);
+}
+
+//
+// The body of an inlined method sees its formals, bound afterwards,
+// and the attributes of its class; the caller's names are restored by
+// exit_inline.
+//
+void CgenContext::enter_inline(CgenNodeP callee)
+{
+  callers.push_back(std::make_pair(cls, vars));
+  cls = callee;
+  vars = SymbolTable<Symbol,Binding>();
+  vars.enterscope();
+}
+
+void CgenContext::exit_inline()
+{
+  cls = callers.back().first;
+  vars = callers.back().second;
+  callers.pop_back();
+}
+
+//
+// A new temporary holding the value of `reg'.
+//
+int CgenContext::save(char *reg, ostream& s)
+{
+  int t = next_temp++;
+  if(recording) {
+    Interval i;
+    i.start = events++;
+    i.end = -1;
+    i.crosses_call = FALSE;
+    temps.push_back(i);
+    return t;
+  }
+
+  if(!allocating) {
+    Interval i;
+    emit_push(reg, s);
+    depth++;
+    i.loc.reg = FP;
+    i.loc.offset = -depth;
+    i.loc.in_register = FALSE;
+    temps.push_back(i);
+    return t;
+  }
+
+  store(t, reg, s);
+  return t;
+}
+
+//
+// The register holding temporary `temp': its own one, or `scratch'
+// after loading it from the frame.
+//
+char *CgenContext::load(int temp, char *scratch, ostream& s)
+{
+  if(recording) {
+    events++;
+    return scratch;
+  }
+
+  Location &l = temps[temp].loc;
+  if(l.in_register)
+    return l.reg;
+  emit_load(scratch, l.offset, l.reg, s);
+  return scratch;
+}
+
+void CgenContext::store(int temp, char *reg, ostream& s)
+{
+  if(recording) {
+    events++;
+    return;
+  }
+
+  Location &l = temps[temp].loc;
+  if(!l.in_register)
+    emit_store(reg, l.offset, l.reg, s);
+  else if(l.reg != reg)
+    emit_move(l.reg, reg, s);
+}
+
+void CgenContext::release(int temp, ostream& s)
+{
+  if(recording) {
+    temps[temp].end = events++;
+    temps[temp].crosses_call = last_call > temps[temp].start;
+    return;
+  }
+
+  if(!allocating) {
+    assert(temps[temp].loc.offset == -depth);
+    emit_addiu(SP, SP, WORD_SIZE, s);
+    depth--;
+  }
+}
+
+void CgenContext::push(char *reg, ostream& s)
+{
+  emit_push(reg, s);
+  depth++;
+}
+
+//
+// Linear scan over the intervals of the recording pass, in order of
+// their start.  When no suitable register is free, the active interval
+// that ends last is spilled to a frame slot (or the new one, if it ends
+// even later), so that registers go to the shorter ranges.
+//
+void CgenContext::allocate()
+{
+  std::vector<int> active;        // intervals holding a register
+  std::vector<int> in_frame;      // intervals holding a frame slot
+  std::vector<char *> free_caller(caller_saved, caller_saved + NCALLER);
+  std::vector<char *> free_callee(callee_saved, callee_saved + NCALLEE);
+  std::vector<int> free_slots;
+  std::vector<int> used_callee(NCALLEE, FALSE);
+
+  for(unsigned i = 0; i < temps.size(); i++) {
+    Interval &cur = temps[i];
+
+    // Expire the intervals that ended before this one starts
+    for(unsigned j = 0; j < active.size(); ) {
+      Interval &old = temps[active[j]];
+      if(old.end < cur.start) {
+        int caller = FALSE;
+        for(int k = 0; k < NCALLER; k++)
+          if(old.loc.reg == caller_saved[k])
+            caller = TRUE;
+        (caller ? free_caller : free_callee).push_back(old.loc.reg);
+        active.erase(active.begin() + j);
+      }
+      else
+        j++;
+    }
+    for(unsigned j = 0; j < in_frame.size(); ) {
+      Interval &old = temps[in_frame[j]];
+      if(old.end < cur.start) {
+        free_slots.push_back(old.loc.offset);
+        in_frame.erase(in_frame.begin() + j);
+      }
+      else
+        j++;
+    }
+
+    char *reg = NULL;
+    if(!cur.crosses_call && !free_caller.empty()) {
+      reg = free_caller.back();
+      free_caller.pop_back();
+    }
+    else if(!free_callee.empty()) {
+      reg = free_callee.back();
+      free_callee.pop_back();
+    }
+    else {
+      // Steal the register of the active interval that ends last, if
+      // it is one this interval may use
+      int victim = -1;
+      for(unsigned j = 0; j < active.size(); j++) {
+        Interval &cand = temps[active[j]];
+        int callee = FALSE;
+        for(int k = 0; k < NCALLEE; k++)
+          if(cand.loc.reg == callee_saved[k])
+            callee = TRUE;
+        if((callee || !cur.crosses_call) &&
+           (victim < 0 || cand.end > temps[active[victim]].end))
+          victim = j;
+      }
+      if(victim >= 0 && temps[active[victim]].end > cur.end) {
+        int v = active[victim];
+        reg = temps[v].loc.reg;
+        active.erase(active.begin() + victim);
+        int slot = nslots;
+        if(!free_slots.empty()) {
+          slot = free_slots.back();
+          free_slots.pop_back();
+        }
+        else
+          nslots++;
+        temps[v].loc.reg = FP;
+        temps[v].loc.offset = slot;
+        temps[v].loc.in_register = FALSE;
+        in_frame.push_back(v);
+      }
+    }
+
+    if(reg != NULL) {
+      cur.loc.reg = reg;
+      cur.loc.offset = 0;
+      cur.loc.in_register = TRUE;
+      active.push_back(i);
+      for(int k = 0; k < NCALLEE; k++)
+        if(reg == callee_saved[k])
+          used_callee[k] = TRUE;
+    }
+    else {
+      int slot = nslots;
+      if(!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+      }
+      else
+        nslots++;
+      cur.loc.reg = FP;
+      cur.loc.offset = slot;
+      cur.loc.in_register = FALSE;
+      in_frame.push_back(i);
+    }
+  }
+
+  for(int k = 0; k < NCALLEE; k++)
+    if(used_callee[k])
+      saved.push_back(callee_saved[k]);
+}
+
+void CgenContext::emit_prologue(ostream& s)
+{
+  int frame = frame_words();
+  emit_addiu(SP, SP, -frame * WORD_SIZE, s);
+  emit_store(FP, frame, SP, s);
+  emit_store(SELF, frame - 1, SP, s);
+  emit_store(RA, frame - 2, SP, s);
+  emit_addiu(FP, SP, WORD_SIZE, s);
+  for(unsigned k = 0; k < saved.size(); k++)
+    emit_store(saved[k], nslots + k, FP, s);
+  emit_move(SELF, ACC, s);
+}
+
+// The callee pops its arguments.
+void CgenContext::emit_epilogue(ostream& s)
+{
+  int frame = frame_words();
+  for(unsigned k = 0; k < saved.size(); k++)
+    emit_load(saved[k], nslots + k, FP, s);
+  emit_load(SELF, frame - 1, SP, s);
+  emit_load(RA, frame - 2, SP, s);
+  emit_load(FP, frame, SP, s);
+  emit_addiu(SP, SP, (frame + nformals) * WORD_SIZE, s);
+  emit_return(s);
+}
+
+//
+// Initializers run the one of the parent class first, then evaluate
+// the attributes that have an initial value, in order.
+//
+static void code_init_body(CgenNodeP nd, CgenContext& ctx, ostream& s)
+{
+  if(nd->get_parentnd() != NULL && nd->get_parent() != No_class) {
+    s << JAL;  emit_init_ref(nd->get_parent(), s);  s << endl;
+    ctx.call();
+  }
+
+  Features fs = nd->features;
+  for(int i = fs->first(); fs->more(i); i = fs->next(i)) {
+    Feature f = fs->nth(i);
+    if(f->isMethod() || ((attr_class *) f)->init->is_empty())
+      continue;
+    attr_class *a = (attr_class *) f;
+    code_as(a->init, ctx.holds_unboxed(a->name) ? a->type_decl : Object, ctx, s);
+    ctx.store_var(a->name, ACC, s);
+  }
+  emit_move(ACC, SELF, s);
+}
+
+void CgenNode::code_init(ostream& s)
+{
+  CgenContext ctx(class_table, this, NULL);
+  if(ctx.allocates_registers()) {
+    int labels = label_count;
+    ctx.begin_pass(TRUE);
+    code_init_body(this, ctx, nowhere);
+    ctx.allocate();
+    label_count = labels;
+  }
+
+  CodeBuffer buf;
+  ostream out(&buf);
+  emit_init_ref(name, out);  out << LABEL;
+  ctx.begin_pass(FALSE);
+  ctx.emit_prologue(out);
+  code_init_body(this, ctx, out);
+  ctx.emit_epilogue(out);
+
+  if(cgen_optimize)
+    peephole(buf.instructions());
+  buf.print(s);
+}
+
+void CgenNode::code_method(method_class *m, ostream& s)
+{
+  CgenContext ctx(class_table, this, m);
+  Symbol result = unboxed_method(m->name) ? m->return_type : Object;
+  if(ctx.allocates_registers()) {
+    int labels = label_count;
+    ctx.begin_pass(TRUE);
+    code_as(m->expr, result, ctx, nowhere);
+    ctx.allocate();
+    label_count = labels;
+  }
+
+  CodeBuffer buf;
+  ostream out(&buf);
+  emit_method_ref(name, m->name, out);  out << LABEL;
+  ctx.begin_pass(FALSE);
+  ctx.emit_prologue(out);
+  code_as(m->expr, result, ctx, out);
+  ctx.emit_epilogue(out);
+
+  if(cgen_optimize)
+    peephole(buf.instructions());
+  buf.print(s);
 }
 
 
@@ -919,85 +1674,664 @@ CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
 //
 //*****************************************************************
 
-void assign_class::code(ostream &s) {
+// The class a static type stands for in the class being coded
+static CgenNodeP static_class(Symbol type, CgenContext& ctx)
+{
+  if(type == SELF_TYPE)
+    return ctx.get_class();
+  return ctx.get_table()->probe(type);
 }
 
-void static_dispatch_class::code(ostream &s) {
+//
+// Runtime errors report the file and line of the expression: the name
+// of the file goes in $a0, the line in $t1.
+//
+static void emit_runtime_error(char *handler, tree_node *e, CgenContext& ctx, ostream& s)
+{
+  Symbol filename = ctx.get_class()->get_filename();
+  emit_load_string(ACC, stringtable.lookup_string(filename->get_string()), s);
+  emit_load_imm(T1, e->get_line_number(), s);
+  emit_jal(handler, s);
+  ctx.call();
 }
 
-void dispatch_class::code(ostream &s) {
+//
+// The default value of a variable of the given type: 0, "" and false
+// for the basic types, void for the others.
+//
+static void emit_default_value(char *dest, Symbol type, ostream& s)
+{
+  if(type == Int)
+    emit_load_int(dest, inttable.lookup_string("0"), s);
+  else if(type == Str)
+    emit_load_string(dest, stringtable.lookup_string(""), s);
+  else if(type == Bool)
+    emit_load_bool(dest, falsebool, s);
+  else
+    emit_move(dest, ZERO, s);
+}
+
+//
+// A raw value is boxed for a variable that holds objects.  Semant gives
+// the assignment the type of the variable, which decides whether its
+// value is unboxed again.
+//
+void assign_class::code(ostream &s, CgenContext& ctx) {
+  if(unboxed(expr->get_type()) && !ctx.holds_unboxed(name)) {
+    code_boxed(expr, ctx, s);
+    ctx.store_var(name, ACC, s);
+    emit_convert(Object, type, ctx, s);
+    return;
+  }
+  expr->code(s, ctx);
+  ctx.store_var(name, ACC, s);
 }
 
-void cond_class::code(ostream &s) {
+static void code_void_check(Expression e, CgenContext& ctx, ostream& s)
+{
+  int ok = label_count++;
+  emit_bnez(ACC, ok, s);
+  emit_runtime_error("_dispatch_abort", e, ctx, s);
+  emit_label_def(ok, s);
 }
 
-void loop_class::code(ostream &s) {
+//
+// Calls whose target is known are inlined with -O when the body of the
+// method has at most INLINE_SIZE nodes, accessors in particular.  The
+// depth limit stops the inlining of recursive methods.
+//
+#define INLINE_SIZE  8
+#define INLINE_DEPTH 2
+
+// The definition of `meth' in the class `owner'
+static method_class *find_method(CgenNodeP owner, Symbol meth)
+{
+  Features fs = owner->features;
+  for(int i = fs->first(); fs->more(i); i = fs->next(i))
+    if(fs->nth(i)->isMethod() && fs->nth(i)->getName() == meth)
+      return (method_class *) fs->nth(i);
+  return NULL;
 }
 
-void typcase_class::code(ostream &s) {
+static method_class *inline_candidate(CgenNodeP owner, Symbol meth, CgenContext& ctx)
+{
+  if(owner->basic() || ctx.inline_depth() >= INLINE_DEPTH)
+    return NULL;
+  method_class *m = find_method(owner, meth);
+  return m->expr->size() <= INLINE_SIZE ? m : NULL;
 }
 
-void block_class::code(ostream &s) {
+//
+// The arguments and the receiver are evaluated as for a call, except
+// that Int and Bool arguments stay unboxed for formals of those types.
+// The body then runs with the receiver in $s0 and the arguments bound
+// to the formals, and the caller's self is put back.
+//
+static void code_inline(Expression e, Expression receiver, CgenNodeP owner, method_class *m,
+                        Expressions actual, CgenContext& ctx, ostream& s)
+{
+  Formals formals = m->formals;
+  std::vector<int> args;
+  for(int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    code_as(actual->nth(i), ((formal_class *) formals->nth(i))->type_decl, ctx, s);
+    args.push_back(ctx.save(ACC, s));
+  }
+
+  receiver->code(s, ctx);
+  code_void_check(e, ctx, s);
+  int caller = ctx.save(SELF, s);
+  emit_move(SELF, ACC, s);
+
+  ctx.enter_inline(owner);
+  for(int i = formals->first(); formals->more(i); i = formals->next(i)) {
+    formal_class *f = (formal_class *) formals->nth(i);
+    ctx.bind(f->name, args[i], f->type_decl);
+  }
+  m->expr->code(s, ctx);
+  emit_convert(m->expr->get_type(), e->get_type(), ctx, s);
+  ctx.exit_inline();
+
+  char *r = ctx.load(caller, SELF, s);
+  if(strcmp(r, SELF) != 0)
+    emit_move(SELF, r, s);
+  ctx.release(caller, s);
+  for(int i = args.size() - 1; i >= 0; i--)
+    ctx.release(args[i], s);
+}
+
+//
+// The arguments are pushed in order, then the receiver is checked for
+// void and the method is called through the dispatch table: the one of
+// the named class for static dispatch, the one of the object otherwise.
+// Int and Bool arguments and results are raw unless the method is one
+// of the basic classes.
+// With -O, a method that all the classes the receiver may have share
+// is called directly, or inlined.
+//
+static void code_dispatch(Expression e, Expression receiver, Symbol static_type,
+                          Symbol meth, Expressions actual, std::vector<int>& receivers,
+                          CgenContext& ctx, ostream& s)
+{
+  CgenNodeP nd;
+  if(static_type != NULL)
+    nd = ctx.get_table()->probe(static_type);
+  else
+    nd = static_class(receiver->get_type(), ctx);
+
+  Symbol target = NULL;
+  if(cgen_optimize)
+    target = static_type != NULL ? nd->method_owner(meth)
+                                 : ctx.get_table()->dispatch_target(nd, meth, receivers);
+  if(target != NULL) {
+    CgenNodeP owner = ctx.get_table()->probe(target);
+    method_class *m = inline_candidate(owner, meth, ctx);
+    if(m != NULL) {
+      code_inline(e, receiver, owner, m, actual, ctx, s);
+      return;
+    }
+  }
+
+  int raw = nd->unboxed_method(meth);
+  method_class *m = find_method(ctx.get_table()->probe(nd->method_owner(meth)), meth);
+  for(int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    Symbol type = ((formal_class *) m->formals->nth(i))->type_decl;
+    code_as(actual->nth(i), raw ? type : Object, ctx, s);
+    ctx.push(ACC, s);
+  }
+
+  // A boxed receiver is never void
+  code_boxed(receiver, ctx, s);
+  if(!unboxed(receiver->get_type()))
+    code_void_check(e, ctx, s);
+
+  if(target != NULL) {
+    s << JAL;  emit_method_ref(target, meth, s);  s << endl;
+  }
+  else {
+    if(static_type != NULL) {
+      emit_partial_load_address(T1, s);  emit_disptable_ref(static_type, s);  s << endl;
+    }
+    else
+      emit_load(T1, DISPTABLE_OFFSET, ACC, s);
+    emit_load(T1, nd->method_offset(meth), T1, s);
+    emit_jalr(T1, s);
+  }
+  ctx.call();
+  ctx.popped(actual->len());
+  emit_convert(raw ? m->return_type : Object, e->get_type(), ctx, s);
+}
+
+void static_dispatch_class::code(ostream &s, CgenContext& ctx) {
+  std::vector<int> none;
+  code_dispatch(this, expr, type_name, name, actual, none, ctx, s);
+}
+
+void dispatch_class::code(ostream &s, CgenContext& ctx) {
+  code_dispatch(this, expr, NULL, name, actual, receivers, ctx, s);
+}
+
+// Goes to `false_label' when the predicate is false
+static void code_test(Expression pred, int false_label, CgenContext& ctx, ostream& s)
+{
+  pred->code(s, ctx);
+  if(unboxed(pred->get_type()))
+    emit_beqz(ACC, false_label, s);
+  else {
+    emit_fetch_int(T1, ACC, s);
+    emit_beqz(T1, false_label, s);
+  }
+}
+
+void cond_class::code(ostream &s, CgenContext& ctx) {
+  int else_label = label_count++;
+  int end_label = label_count++;
+
+  code_test(pred, else_label, ctx, s);
+  then_exp->code(s, ctx);
+  emit_convert(then_exp->get_type(), type, ctx, s);
+  emit_branch(end_label, s);
+  emit_label_def(else_label, s);
+  else_exp->code(s, ctx);
+  emit_convert(else_exp->get_type(), type, ctx, s);
+  emit_label_def(end_label, s);
 }
 
-void let_class::code(ostream &s) {
+void loop_class::code(ostream &s, CgenContext& ctx) {
+  int loop_label = label_count++;
+  int end_label = label_count++;
+
+  emit_label_def(loop_label, s);
+  code_test(pred, end_label, ctx, s);
+  body->code(s, ctx);
+  emit_branch(loop_label, s);
+  emit_label_def(end_label, s);
+  emit_move(ACC, ZERO, s);
 }
 
-void plus_class::code(ostream &s) {
+//
+// Case expressions with at least this many branches select the branch
+// through a table indexed by class tag.
+//
+#define CASE_TABLE_BRANCHES 6
+
+//
+// Fills the jump table of a case: every class goes to the branch of
+// its closest ancestor that has one, or to `nomatch'.
+//
+static void fill_case_table(CgenNodeP nd, int label, std::map<Symbol,int>& branch_labels,
+                            std::vector<int>& table)
+{
+  std::map<Symbol,int>::iterator b = branch_labels.find(nd->get_name());
+  if(b != branch_labels.end())
+    label = b->second;
+  table[nd->get_tag()] = label;
+  for(List<CgenNode> *l = nd->get_children(); l; l = l->tl())
+    fill_case_table(l->hd(), label, branch_labels, table);
+}
+
+//
+// A branch runs with the object in $a0 bound to its variable, unboxed
+// for an Int or Bool branch.
+//
+static void code_case_branch(branch_class *b, Symbol type, int end_label,
+                             CgenContext& ctx, ostream& s)
+{
+  ctx.enterscope();
+  emit_convert(Object, b->type_decl, ctx, s);
+  int t = ctx.save(ACC, s);
+  ctx.bind(b->name, t, b->type_decl);
+  b->expr->code(s, ctx);
+  emit_convert(b->expr->get_type(), type, ctx, s);
+  ctx.release(t, s);
+  ctx.exitscope();
+  emit_branch(end_label, s);
+}
+
+//
+// The classes conforming to a branch's class have the tags between its
+// tag and the highest one of its subtree, so a branch is chosen by one
+// range check on the tag of the object.  The branches are tried from
+// the highest tag down: when two ranges overlap, the one with the
+// higher tag is the nested one, i.e. the closer ancestor.  Large cases
+// instead jump through a table built here, with one entry per class.
+//
+void typcase_class::code(ostream &s, CgenContext& ctx) {
+  code_boxed(expr, ctx, s);
+  int ok = label_count++;
+  emit_bnez(ACC, ok, s);
+  emit_runtime_error("_case_abort2", this, ctx, s);
+  emit_label_def(ok, s);
+
+  CgenClassTableP table = ctx.get_table();
+  std::vector<branch_class *> branches;
+  for(int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = (branch_class *) cases->nth(i);
+    unsigned j = branches.size();
+    int tag = table->probe(b->type_decl)->get_tag();
+    while(j > 0 && table->probe(branches[j - 1]->type_decl)->get_tag() < tag)
+      j--;
+    branches.insert(branches.begin() + j, b);
+  }
+
+  int end_label = label_count++;
+  emit_load(T2, TAG_OFFSET, ACC, s);
+
+  if(branches.size() < CASE_TABLE_BRANCHES) {
+    for(unsigned i = 0; i < branches.size(); i++) {
+      CgenNodeP nd = table->probe(branches[i]->type_decl);
+      int next = label_count++;
+      emit_blti(T2, nd->get_tag(), next, s);
+      emit_bgti(T2, nd->get_max_tag(), next, s);
+      code_case_branch(branches[i], type, end_label, ctx, s);
+      emit_label_def(next, s);
+    }
+    emit_jal("_case_abort", s);
+    ctx.call();
+    emit_label_def(end_label, s);
+    return;
+  }
+
+  int table_label = label_count++;
+  int nomatch = label_count++;
+  std::map<Symbol,int> branch_labels;
+  for(unsigned i = 0; i < branches.size(); i++)
+    branch_labels[branches[i]->type_decl] = label_count++;
+
+  std::vector<int> targets(table->class_count(), nomatch);
+  fill_case_table(table->root(), nomatch, branch_labels, targets);
+  s << "\t.data" << endl;
+  emit_label_def(table_label, s);
+  for(unsigned i = 0; i < targets.size(); i++) {
+    s << WORD;  emit_label_ref(targets[i], s);  s << endl;
+  }
+  s << "\t.text" << endl;
+
+  emit_partial_load_address(T1, s);  emit_label_ref(table_label, s);  s << endl;
+  emit_sll(T2, T2, LOG_WORD_SIZE, s);
+  emit_addu(T1, T1, T2, s);
+  emit_load(T1, 0, T1, s);
+  emit_jr(T1, s);
+
+  emit_label_def(nomatch, s);
+  emit_jal("_case_abort", s);
+  ctx.call();
+  for(unsigned i = 0; i < branches.size(); i++) {
+    emit_label_def(branch_labels[branches[i]->type_decl], s);
+    code_case_branch(branches[i], type, end_label, ctx, s);
+  }
+  emit_label_def(end_label, s);
+}
+
+void block_class::code(ostream &s, CgenContext& ctx) {
+  for(int i = body->first(); body->more(i); i = body->next(i))
+    body->nth(i)->code(s, ctx);
+}
+
+void let_class::code(ostream &s, CgenContext& ctx) {
+  if(!init->is_empty())
+    code_as(init, type_decl, ctx, s);
+  else if(unboxed(type_decl))
+    emit_load_imm(ACC, 0, s);
+  else
+    emit_default_value(ACC, type_decl, s);
+
+  ctx.enterscope();
+  int t = ctx.save(ACC, s);
+  ctx.bind(identifier, t, type_decl);
+  body->code(s, ctx);
+  ctx.release(t, s);
+  ctx.exitscope();
+}
+
+//
+// Arithmetic on boxed values works on a fresh copy of the right
+// operand, which then receives the result.
+//
+static void code_arith(Expression e1, Expression e2,
+                       void (*op)(char *, char *, char *, ostream&),
+                       CgenContext& ctx, ostream& s)
+{
+  e1->code(s, ctx);
+  int t = ctx.save(ACC, s);
+  e2->code(s, ctx);
+  if(unboxing) {
+    char *r = ctx.load(t, T1, s);
+    op(ACC, r, ACC, s);
+    ctx.release(t, s);
+    return;
+  }
+  emit_jal("Object.copy", s);
+  ctx.call();
+  char *r = ctx.load(t, T1, s);
+  emit_fetch_int(T1, r, s);
+  emit_fetch_int(T2, ACC, s);
+  op(T1, T1, T2, s);
+  emit_store_int(T1, ACC, s);
+  ctx.release(t, s);
 }
 
-void sub_class::code(ostream &s) {
+void plus_class::code(ostream &s, CgenContext& ctx) {
+  code_arith(e1, e2, emit_add, ctx, s);
 }
 
-void mul_class::code(ostream &s) {
+void sub_class::code(ostream &s, CgenContext& ctx) {
+  code_arith(e1, e2, emit_sub, ctx, s);
 }
 
-void divide_class::code(ostream &s) {
+void mul_class::code(ostream &s, CgenContext& ctx) {
+  code_arith(e1, e2, emit_mul, ctx, s);
 }
 
-void neg_class::code(ostream &s) {
+void divide_class::code(ostream &s, CgenContext& ctx) {
+  code_arith(e1, e2, emit_div, ctx, s);
 }
 
-void lt_class::code(ostream &s) {
+void neg_class::code(ostream &s, CgenContext& ctx) {
+  e1->code(s, ctx);
+  if(unboxing) {
+    emit_neg(ACC, ACC, s);
+    return;
+  }
+  emit_jal("Object.copy", s);
+  ctx.call();
+  emit_fetch_int(T1, ACC, s);
+  emit_neg(T1, T1, s);
+  emit_store_int(T1, ACC, s);
 }
 
-void eq_class::code(ostream &s) {
+//
+// Comparisons of integers: true is loaded first and replaced by false
+// when the branch is not taken.
+//
+static void code_compare(Expression e1, Expression e2,
+                         void (*branch)(char *, char *, int, ostream&),
+                         CgenContext& ctx, ostream& s)
+{
+  e1->code(s, ctx);
+  int t = ctx.save(ACC, s);
+  e2->code(s, ctx);
+  char *r = ctx.load(t, T1, s);
+  if(unboxing) {
+    if(strcmp(r, T1) != 0)
+      emit_move(T1, r, s);
+    emit_move(T2, ACC, s);
+  }
+  else {
+    emit_fetch_int(T1, r, s);
+    emit_fetch_int(T2, ACC, s);
+  }
+  ctx.release(t, s);
+
+  int done = label_count++;
+  emit_load_truth(ACC, TRUE, s);
+  branch(T1, T2, done, s);
+  emit_load_truth(ACC, FALSE, s);
+  emit_label_def(done, s);
+}
+
+void lt_class::code(ostream &s, CgenContext& ctx) {
+  code_compare(e1, e2, emit_blt, ctx, s);
+}
+
+//
+// Identical pointers are equal; otherwise the runtime compares the
+// values of Ints, Strings and Bools.  Unboxed operands are equal when
+// their values are, and equality_test only passes its $a0 or $a1 on,
+// so it also works with raw truth values.
+//
+void eq_class::code(ostream &s, CgenContext& ctx) {
+  e1->code(s, ctx);
+  int t = ctx.save(ACC, s);
+  e2->code(s, ctx);
+  emit_move(T2, ACC, s);
+  char *r = ctx.load(t, T1, s);
+  if(strcmp(r, T1) != 0)
+    emit_move(T1, r, s);
+  ctx.release(t, s);
+
+  int done = label_count++;
+  emit_load_truth(ACC, TRUE, s);
+  emit_beq(T1, T2, done, s);
+  if(unboxed(e1->get_type()))
+    emit_load_truth(ACC, FALSE, s);
+  else {
+    emit_load_truth(A1, FALSE, s);
+    emit_jal("equality_test", s);
+    ctx.call();
+  }
+  emit_label_def(done, s);
 }
 
-void leq_class::code(ostream &s) {
+void leq_class::code(ostream &s, CgenContext& ctx) {
+  code_compare(e1, e2, emit_bleq, ctx, s);
 }
 
-void comp_class::code(ostream &s) {
+void comp_class::code(ostream &s, CgenContext& ctx) {
+  e1->code(s, ctx);
+  if(unboxing) {
+    emit_load_imm(T1, TRUE, s);
+    emit_sub(ACC, T1, ACC, s);
+    return;
+  }
+  emit_fetch_int(T1, ACC, s);
+  int done = label_count++;
+  emit_load_bool(ACC, truebool, s);
+  emit_beqz(T1, done, s);
+  emit_load_bool(ACC, falsebool, s);
+  emit_label_def(done, s);
 }
 
-void int_const_class::code(ostream& s)  
+void int_const_class::code(ostream& s, CgenContext& ctx)  
 {
+  if(unboxing) {
+    emit_load_imm(ACC, (int) strtoll(token->get_string(), NULL, 10), s);
+    return;
+  }
   //
   // Need to be sure we have an IntEntry *, not an arbitrary Symbol
   //
   emit_load_int(ACC,inttable.lookup_string(token->get_string()),s);
 }
 
-void string_const_class::code(ostream& s)
+void string_const_class::code(ostream& s, CgenContext& ctx)
 {
   emit_load_string(ACC,stringtable.lookup_string(token->get_string()),s);
 }
 
-void bool_const_class::code(ostream& s)
+void bool_const_class::code(ostream& s, CgenContext& ctx)
 {
-  emit_load_bool(ACC, BoolConst(val), s);
+  if(unboxing)
+    emit_load_imm(ACC, val, s);
+  else
+    emit_load_bool(ACC, BoolConst(val), s);
 }
 
-void new__class::code(ostream &s) {
+//
+// new SELF_TYPE finds the prototype and initializer of the class of
+// self in class_objTab, two words per class tag.
+//
+void new__class::code(ostream &s, CgenContext& ctx) {
+  if(unboxed(type_name)) {
+    emit_load_imm(ACC, 0, s);
+    return;
+  }
+  if(type_name != SELF_TYPE) {
+    emit_partial_load_address(ACC, s);  emit_protobj_ref(type_name, s);  s << endl;
+    emit_jal("Object.copy", s);
+    ctx.call();
+    s << JAL;  emit_init_ref(type_name, s);  s << endl;
+    ctx.call();
+    return;
+  }
+
+  emit_load_address(T1, CLASSOBJTAB, s);
+  emit_load(T2, TAG_OFFSET, SELF, s);
+  emit_sll(T2, T2, LOG_WORD_SIZE + 1, s);
+  emit_addu(T1, T1, T2, s);
+  int t = ctx.save(T1, s);
+  emit_load(ACC, 0, T1, s);
+  emit_jal("Object.copy", s);
+  ctx.call();
+  char *r = ctx.load(t, T1, s);
+  emit_load(T1, 1, r, s);
+  ctx.release(t, s);
+  emit_jalr(T1, s);
+  ctx.call();
+}
+
+// An unboxed value is never void
+void isvoid_class::code(ostream &s, CgenContext& ctx) {
+  e1->code(s, ctx);
+  if(unboxed(e1->get_type())) {
+    emit_load_imm(ACC, FALSE, s);
+    return;
+  }
+  emit_move(T1, ACC, s);
+  int done = label_count++;
+  emit_load_truth(ACC, TRUE, s);
+  emit_beqz(T1, done, s);
+  emit_load_truth(ACC, FALSE, s);
+  emit_label_def(done, s);
 }
 
-void isvoid_class::code(ostream &s) {
+void no_expr_class::code(ostream &s, CgenContext& ctx) {
 }
 
-void no_expr_class::code(ostream &s) {
+void object_class::code(ostream &s, CgenContext& ctx) {
+  if(name == self)
+    emit_move(ACC, SELF, s);
+  else {
+    ctx.load_var(ACC, name, s);
+    if(unboxed(type) && !ctx.holds_unboxed(name))
+      emit_fetch_int(ACC, ACC, s);
+  }
 }
 
-void object_class::code(ostream &s) {
+///////////////////////////////////////////////////////////////////////
+//
+// size: the number of nodes of an expression, which decides whether a
+// method body is small enough to be inlined
+//
+///////////////////////////////////////////////////////////////////////
+
+static int list_size(Expressions es)
+{
+  int n = 0;
+  for(int i = es->first(); es->more(i); i = es->next(i))
+    n += es->nth(i)->size();
+  return n;
 }
 
+int assign_class::size() { return 1 + expr->size(); }
+
+int static_dispatch_class::size() { return 1 + expr->size() + list_size(actual); }
+
+int dispatch_class::size() { return 1 + expr->size() + list_size(actual); }
+
+int cond_class::size() { return 1 + pred->size() + then_exp->size() + else_exp->size(); }
+
+int loop_class::size() { return 1 + pred->size() + body->size(); }
+
+int typcase_class::size()
+{
+  int n = 1 + expr->size();
+  for(int i = cases->first(); cases->more(i); i = cases->next(i))
+    n += 1 + ((branch_class *) cases->nth(i))->expr->size();
+  return n;
+}
+
+int block_class::size() { return 1 + list_size(body); }
+
+int let_class::size() { return 1 + init->size() + body->size(); }
+
+int plus_class::size() { return 1 + e1->size() + e2->size(); }
+
+int sub_class::size() { return 1 + e1->size() + e2->size(); }
+
+int mul_class::size() { return 1 + e1->size() + e2->size(); }
+
+int divide_class::size() { return 1 + e1->size() + e2->size(); }
+
+int neg_class::size() { return 1 + e1->size(); }
+
+int lt_class::size() { return 1 + e1->size() + e2->size(); }
+
+int eq_class::size() { return 1 + e1->size() + e2->size(); }
+
+int leq_class::size() { return 1 + e1->size() + e2->size(); }
+
+int comp_class::size() { return 1 + e1->size(); }
+
+int int_const_class::size() { return 1; }
+
+int bool_const_class::size() { return 1; }
+
+int string_const_class::size() { return 1; }
+
+int new__class::size() { return 1; }
+
+int isvoid_class::size() { return 1 + e1->size(); }
+
+int no_expr_class::size() { return 0; }
 
+int object_class::size() { return 1; }
@@ -1,5 +1,10 @@
 #include <assert.h>
 #include <stdio.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <streambuf>
 #include "emit.h"
 #include "cool-tree.h"
 #include "symtab.h"
@@ -17,6 +22,7 @@ typedef CgenNode *CgenNodeP;
 class CgenClassTable : public SymbolTable<Symbol,CgenNode> {
 private:
    List<CgenNode> *nds;
+   std::vector<CgenNodeP> classes_by_tag;
    ostream& str;
    int stringclasstag;
    int intclasstag;
@@ -42,10 +48,21 @@ private:
    void install_classes(Classes cs);
    void build_inheritance_tree();
    void set_relations(CgenNodeP nd);
+
+// The following assign the class tags and lay out the objects, and
+// emit the per-class code (prototypes, initializers and methods).
+
+   void code_class_tables();
+   void code_prototypes();
+   void code_methods();
 public:
    CgenClassTable(Classes, ostream& str);
    void code();
+   void code_c();
    CgenNodeP root();
+   int class_count() { return classes_by_tag.size(); }
+   CgenNodeP class_by_tag(int tag) { return classes_by_tag[tag]; }
+   Symbol dispatch_target(CgenNodeP nd, Symbol meth, std::vector<int>& receivers);
 };
 
 
@@ -55,6 +72,13 @@ private:
    List<CgenNode> *children;                  // Children of class
    Basicness basic_status;                    // `Basic' if class is basic
                                               // `NotBasic' otherwise
+   CgenClassTableP class_table;
+   int tag;                                   // Class tag of the objects
+   int max_tag;                               // Highest tag in the subtree
+   std::vector<attr_class *> attributes;      // Layout, inherited ones first
+   std::vector<Symbol> method_names;          // Dispatch table, slot by slot,
+   std::vector<Symbol> method_owners;         //   and the class defining each
+   std::map<Symbol,int> method_slots;         // Slot of each method name
 
 public:
    CgenNode(Class_ c,
@@ -66,11 +90,204 @@ public:
    void set_parentnd(CgenNodeP p);
    CgenNodeP get_parentnd() { return parentnd; }
    int basic() { return (basic_status == Basic); }
+   int get_tag() { return tag; }
+   int get_max_tag() { return max_tag; }
+
+   int number(int next, std::vector<CgenNodeP>& by_tag);
+   void layout();
+   int attribute_offset(Symbol attr);
+   int attribute_count() { return attributes.size(); }
+   int unboxed_attribute(Symbol attr);
+   int method_offset(Symbol meth);
+   int unboxed_method(Symbol meth);
+   Symbol method_owner(Symbol meth) { return method_owners[method_offset(meth)]; }
+   Symbol dispatch_target(Symbol meth);
 
    void emit_dispatch_table(ostream&);
+   void code_protobj(ostream&);
+   void code_init(ostream&);
+   void code_method(method_class *m, ostream&);
+
+// The same for the C backend (cgen_c.cc)
+
+   void code_c_struct(ostream&);
+   void code_c_vtable_type(ostream&);
+   void code_c_vtable(ostream&);
+   void code_c_slots(CgenNodeP level, ostream&);
+   void code_c_prototypes(ostream&);
+   void code_c_routines(ostream&);
+};
+
+//
+// Where a value lives while a method is being coded: in a register, or
+// in the word `offset' words away from the base register `reg'.
+//
+struct Location {
+   char *reg;
+   int offset;
+   int in_register;
+};
+
+//
+// A temporary of the method being coded: a value that has to survive
+// the evaluation of other subexpressions (left operands, let and case
+// variables).  Temporaries are requested and released in stack order;
+// `start' and `end' are the events at which the value is defined and
+// dies, and `crosses_call' tells whether a call happens in between.
+//
+struct Interval {
+   int start;
+   int end;
+   int crosses_call;
+   Location loc;
+};
+
+// How a name in scope is reached
+struct Binding {
+   enum { Attribute, Formal, Temporary } kind;
+   int index;
+   int unboxed;               // holds a raw Int or Bool
+};
+
+//
+// CgenContext carries the state of the routine being coded: the names
+// in scope and the temporaries.  With register allocation on, the body
+// is coded twice.  The first pass only records the live range of every
+// temporary, a linear scan over those intervals gives each one a
+// register (or a frame slot when none is free), and the second pass
+// emits the code using those locations.  Without it, temporaries are
+// pushed on the stack as they are created.  The body of a method that
+// is inlined at a call is coded in the context of the caller, with the
+// names of the caller out of sight.
+//
+class CgenContext {
+private:
+   CgenClassTableP table;
+   CgenNodeP cls;
+   SymbolTable<Symbol,Binding> vars;
+   std::vector<Interval> temps;
+   int next_temp;             // next temporary requested in this pass
+   int events;                // positions of definitions, uses and calls
+   int last_call;             // event of the latest call
+   int depth;                 // words pushed since the frame was set up
+   int nformals;
+   int nslots;                // frame words for spilled temporaries
+   std::vector<char *> saved; // callee-saved registers the routine uses
+   int allocating;
+   int recording;             // first pass: collect the intervals only
+   std::vector<std::pair<CgenNodeP, SymbolTable<Symbol,Binding> > >
+       callers;               // scopes hidden by the inlined bodies
+
+   int frame_words() { return 3 + nslots + saved.size(); }
+   Location formal_location(int index);
+
+public:
+   CgenContext(CgenClassTableP t, CgenNodeP c, method_class *m);
+
+   CgenClassTableP get_table() { return table; }
+   CgenNodeP get_class() { return cls; }
+   int allocates_registers() { return allocating; }
+   void begin_pass(int record);
+   void allocate();
+
+   void enterscope() { vars.enterscope(); }
+   void exitscope() { vars.exitscope(); }
+   void bind(Symbol name, int temp, Symbol type);
+   int holds_unboxed(Symbol name);
+   void enter_inline(CgenNodeP callee);
+   void exit_inline();
+   int inline_depth() { return callers.size(); }
+   void load_var(char *dest, Symbol name, ostream& s);
+   void store_var(Symbol name, char *source, ostream& s);
+
+   int save(char *reg, ostream& s);
+   char *load(int temp, char *scratch, ostream& s);
+   void store(int temp, char *reg, ostream& s);
+   void release(int temp, ostream& s);
+
+   void push(char *reg, ostream& s);
+   void popped(int words) { depth -= words; }
+   void call() { last_call = events++; }
+
+   void emit_prologue(ostream& s);
+   void emit_epilogue(ostream& s);
+};
+
+//
+// CContext is the state of the C function being written by the C
+// backend: the locals in scope with their declared types, the count of
+// temporaries, and the nesting depth for indentation.  Every value is
+// computed into a fresh temporary, so that the C code evaluates the
+// subexpressions in Cool order.
+//
+class CContext {
+private:
+   CgenClassTableP table;
+   CgenNodeP cls;
+   SymbolTable<Symbol,Entry> vars;
+   int temps;
+   int depth;
+
+public:
+   CContext(CgenClassTableP t, CgenNodeP c);
+
+   CgenClassTableP get_table() { return table; }
+   CgenNodeP get_class() { return cls; }
+
+   void enterscope() { vars.enterscope(); }
+   void exitscope() { vars.exitscope(); }
+   void bind(Symbol name, Symbol type) { vars.addid(name, type); }
+   Symbol var_type(Symbol name);
+   std::string var(Symbol name);
+
+   std::string indent() { return std::string(2 * depth, ' '); }
+   void open(const std::string& head, ostream& s);
+   void close(ostream& s);
+   std::string declare(Symbol type, ostream& s);
+   std::string temp(Symbol type, const std::string& value, ostream& s);
 };
 
-class BoolConst 
+//
+// ConstEnv maps the names in scope to the constant they are known to
+// hold while the AST is folded (fold.cc).  A name bound to NULL is not
+// a constant; it hides any outer binding of the same name.
+//
+class ConstEnv : public SymbolTable<Symbol,Expression_class> { };
+
+void fold_constants(Classes classes);
+
+//
+// Receivers is the rapid type analysis run with -O (receivers.cc).
+// Starting from Main.main, it follows the classes whose objects may be
+// created and the methods and attribute initializers that may run, and
+// gives every dispatch that may run the tags of the classes that its
+// receiver may have.
+//
+class Receivers {
+private:
+   CgenClassTableP table;
+   std::vector<int> live;                      // by tag
+   std::set<Feature> reached;
+   std::vector<std::pair<CgenNodeP, Expression> > pending;
+   std::map<Symbol, std::vector<CgenNodeP> > dispatched;
+                                               // static classes of the
+                                               //   receivers, by method
+   std::vector<std::pair<dispatch_class *, CgenNodeP> > sites;
+   CgenNodeP cls;                              // class of the code followed
+
+   void follow(CgenNodeP c, Feature f, Expression e);
+   void reach_method(Symbol owner, Symbol meth);
+
+public:
+   Receivers(CgenClassTableP t);
+   void run();
+
+   void create(Symbol type);
+   void call(Symbol type, Symbol meth);
+   void dispatch(dispatch_class *call);
+};
+
+class BoolConst
 {
  private: 
   int val;
@@ -80,3 +297,53 @@ class BoolConst
   void code_ref(ostream&) const;
 };
 
+
+//
+// The code of a routine is collected as a list of instructions before
+// it is printed, so that it can be improved as a whole.  Each entry is
+// a label definition, an instruction or an assembler directive, with
+// its operands split.
+//
+struct Instr {
+  std::string label;                  // set for label definitions only
+  std::string op;
+  std::vector<std::string> args;
+};
+
+//
+// CodeBuffer is the stream buffer the emit_ functions write a routine
+// to: every line they produce becomes an Instr.
+//
+class CodeBuffer : public std::streambuf {
+private:
+  std::vector<Instr> code;
+  std::string line;
+  void add_line();
+protected:
+  int overflow(int c);
+public:
+  std::vector<Instr>& instructions() { return code; }
+  void print(ostream& s);
+};
+
+bool parse_instr(const std::string& line, Instr& in);
+void peephole(std::vector<Instr>& code);
+void print_peephole_stats(ostream& s);
+
+//
+// X86Lowering translates the MIPS assembly written to it into x86-64
+// GNU assembly for Linux, line by line, and passes it on to `out'.
+// The object layout and the calling convention stay those of the MIPS
+// code; x86-runtime.c provides the runtime system.
+//
+class X86Lowering : public std::streambuf {
+private:
+  ostream& out;
+  std::string line;
+  int started;
+  void lower_line();
+protected:
+  int overflow(int c);
+public:
+  X86Lowering(ostream& s) : out(s), started(FALSE) { }
+};
@@ -0,0 +1,725 @@
+//////////////////////////////////////////////////////////////////////
+//
+// cgen_c.cc
+//
+// The C backend (-C).  Instead of MIPS assembly the program is written
+// as one C translation unit, to be compiled by the system C compiler
+// and linked with c-runtime.c:
+//
+//   - a struct per class, holding the struct of its parent first and
+//     then its own attributes;
+//   - a dispatch table per class, a struct of function pointers with
+//     the slots of the MIPS table, headed by the class descriptor;
+//   - a function per method, and a constructor (X_new) and an
+//     initializer (X_init) per class.
+//
+// Int and Bool values are int32_t and get boxed only where they flow
+// into a location of another type.  Arithmetic wraps around at 32
+// bits as on MIPS, and the class tags are the MIPS ones, so a case
+// picks its branch with the same tag ranges.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <sstream>
+#include "cgen.h"
+
+extern int cgen_debug;
+extern int cgen_optimize;
+extern Symbol Bool, Int, Str, Object, SELF_TYPE, No_class, self, Main, main_meth;
+
+static std::string str(Symbol s) { return s->get_string(); }
+
+static std::string str(int i)
+{
+  std::ostringstream os;
+  os << i;
+  return os.str();
+}
+
+static int unboxed(Symbol type) { return type == Int || type == Bool; }
+
+static std::string c_type(Symbol type) { return unboxed(type) ? "int32_t" : "obj"; }
+
+//
+// A value of static type `from' used where one of type `to' is
+// expected: Int and Bool values get boxed when `to' is a class, and
+// unboxed when a value known only as an object is an Int or a Bool.
+//
+static std::string convert(const std::string& value, Symbol from, Symbol to)
+{
+  if (unboxed(from) == unboxed(to))
+    return value;
+  if (from == Int)
+    return "cool_box_int(" + value + ")";
+  if (from == Bool)
+    return "cool_box_bool(" + value + ")";
+  return "cool_unbox(" + value + ")";
+}
+
+static std::string c_string(char *chars, int len)
+{
+  std::string s = "\"";
+  for (int i = 0; i < len; i++) {
+    unsigned char c = chars[i];
+    if (c == '"' || c == '\\')
+      s += std::string("\\") + (char) c;
+    else if (isprint(c) && c != '?')
+      s += c;
+    else {
+      char octal[8];
+      sprintf(octal, "\\%03o", c);
+      s += octal;
+    }
+  }
+  return s + "\"";
+}
+
+// C names of the string constants, by string table entry
+static std::map<Symbol,int> string_numbers;
+
+static std::string string_ref(Symbol s)
+{
+  return "((obj) &str_" + str(string_numbers[s]) + ")";
+}
+
+// Only self and the constants are known not to be void
+static int may_be_void(const std::string& value)
+{
+  return value != "self" && value.compare(0, 6, "((obj)") != 0;
+}
+
+static std::string empty_string()
+{
+  return string_ref(stringtable.lookup_string(""));
+}
+
+// The default value of a variable of the given type
+static std::string default_value(Symbol type)
+{
+  if (unboxed(type))
+    return "0";
+  if (type == Str)
+    return empty_string();
+  return "NULL";
+}
+
+//
+// The declarations visible in a class: the closest definition of an
+// attribute or a method, and the class it is in.  Methods may be
+// missing, attributes may not.
+//
+static attr_class *find_attribute(CgenNodeP nd, Symbol name, CgenNodeP *owner)
+{
+  for (; nd != NULL && nd->get_name() != No_class; nd = nd->get_parentnd()) {
+    Features fs = nd->features;
+    for (int i = fs->first(); fs->more(i); i = fs->next(i))
+      if (!fs->nth(i)->isMethod() && fs->nth(i)->getName() == name) {
+        *owner = nd;
+        return (attr_class *) fs->nth(i);
+      }
+  }
+  assert(0);
+  return NULL;
+}
+
+static method_class *find_method(CgenNodeP nd, Symbol name, CgenNodeP *owner)
+{
+  for (; nd != NULL && nd->get_name() != No_class; nd = nd->get_parentnd()) {
+    Features fs = nd->features;
+    for (int i = fs->first(); fs->more(i); i = fs->next(i))
+      if (fs->nth(i)->isMethod() && fs->nth(i)->getName() == name) {
+        *owner = nd;
+        return (method_class *) fs->nth(i);
+      }
+  }
+  return NULL;
+}
+
+// The class whose dispatch table struct has the slot of a method
+static CgenNodeP slot_class(CgenNodeP nd, Symbol meth)
+{
+  CgenNodeP owner;
+  while (nd->get_parent() != No_class && find_method(nd->get_parentnd(), meth, &owner))
+    nd = nd->get_parentnd();
+  return nd;
+}
+
+// An attribute of `object', reached through the struct defining it
+static std::string attribute_ref(CgenNodeP nd, Symbol name, const std::string& object)
+{
+  CgenNodeP owner;
+  find_attribute(nd, name, &owner);
+  return "((struct " + str(owner->get_name()) + " *) " + object + ")->a_" + str(name);
+}
+
+//
+// The C declaration of a method, as the function `name' or, without
+// parameter names, as a pointer in a dispatch table.
+//
+static std::string c_method(method_class *m, const std::string& name, int named)
+{
+  std::string decl = c_type(m->return_type) + " " + name + "(obj";
+  if (named)
+    decl += " self";
+  Formals fs = m->formals;
+  for (int i = fs->first(); fs->more(i); i = fs->next(i)) {
+    formal_class *f = (formal_class *) fs->nth(i);
+    decl += ", " + c_type(f->type_decl);
+    if (named)
+      decl += " v_" + str(f->name);
+  }
+  return decl + ")";
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CContext
+//
+///////////////////////////////////////////////////////////////////////
+
+CContext::CContext(CgenClassTableP t, CgenNodeP c) :
+   table(t), cls(c), temps(0), depth(1)
+{
+  vars.enterscope();
+}
+
+// The declared type of a name in scope: a local or an attribute
+Symbol CContext::var_type(Symbol name)
+{
+  Symbol type = vars.lookup(name);
+  if (type != NULL)
+    return type;
+  CgenNodeP owner;
+  return find_attribute(cls, name, &owner)->type_decl;
+}
+
+std::string CContext::var(Symbol name)
+{
+  if (vars.lookup(name) != NULL)
+    return "v_" + str(name);
+  return attribute_ref(cls, name, "self");
+}
+
+void CContext::open(const std::string& head, ostream& s)
+{
+  s << indent() << head << " {" << endl;
+  depth++;
+}
+
+void CContext::close(ostream& s)
+{
+  depth--;
+  s << indent() << "}" << endl;
+}
+
+std::string CContext::declare(Symbol type, ostream& s)
+{
+  std::string t = "t" + str(temps++);
+  s << indent() << c_type(type) << " " << t << ";" << endl;
+  return t;
+}
+
+std::string CContext::temp(Symbol type, const std::string& value, ostream& s)
+{
+  std::string t = "t" + str(temps++);
+  s << indent() << c_type(type) << " " << t << " = " << value << ";" << endl;
+  return t;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// Classes
+//
+///////////////////////////////////////////////////////////////////////
+
+// The basic classes have their structs in c-runtime.h
+void CgenNode::code_c_struct(ostream& s)
+{
+  if (basic())
+    return;
+
+  s << "struct " << name << " {" << endl
+    << "  struct " << parent << " parent;" << endl;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isMethod())
+      s << "  " << c_type(((attr_class *) f)->type_decl) << " a_" << f->getName() << ";" << endl;
+  }
+  s << "};" << endl << endl;
+}
+
+void CgenNode::code_c_vtable_type(ostream& s)
+{
+  unsigned inherited = 0;
+  s << "struct " << name << "_vtab {" << endl;
+  if (parent == No_class)
+    s << "  struct cool_class cls;" << endl;
+  else {
+    s << "  struct " << parent << "_vtab parent;" << endl;
+    inherited = parentnd->method_names.size();
+  }
+
+  for (unsigned i = inherited; i < method_names.size(); i++) {
+    CgenNodeP owner;
+    method_class *m = find_method(this, method_names[i], &owner);
+    s << "  " << c_method(m, "(*m_" + str(method_names[i]) + ")", FALSE) << ";" << endl;
+  }
+  s << "};" << endl << endl;
+}
+
+//
+// The initializer of the part of this class's dispatch table laid out
+// like the table of `level', one of its ancestors.
+//
+void CgenNode::code_c_slots(CgenNodeP level, ostream& s)
+{
+  unsigned inherited = 0;
+  s << "{ ";
+  if (level->parent == No_class)
+    s << "{ " << tag << ", " << string_ref(stringtable.lookup_string(name->get_string()))
+      << ", sizeof(struct " << name << "), " << name << "_new }";
+  else {
+    code_c_slots(level->parentnd, s);
+    inherited = level->parentnd->method_names.size();
+  }
+
+  for (unsigned i = inherited; i < level->method_names.size(); i++)
+    s << ", " << method_owners[i] << "__" << method_names[i];
+  s << " }";
+}
+
+void CgenNode::code_c_vtable(ostream& s)
+{
+  s << "static const struct " << name << "_vtab " << name << "_vtab = ";
+  code_c_slots(this, s);
+  s << ";" << endl;
+}
+
+void CgenNode::code_c_prototypes(ostream& s)
+{
+  s << "static obj " << name << "_new(void);" << endl;
+  if (name == Int || name == Bool || name == Str)
+    return;
+  s << "static void " << name << "_init(obj self);" << endl;
+  if (basic())
+    return;
+
+  for (int i = features->first(); features->more(i); i = features->next(i))
+    if (features->nth(i)->isMethod()) {
+      method_class *m = (method_class *) features->nth(i);
+      s << "static " << c_method(m, str(name) + "__" + str(m->name), TRUE) << ";" << endl;
+    }
+}
+
+//
+// The constructor allocates the object, which comes zeroed, sets the
+// String attributes to "" and runs the initializer.  The initializer
+// runs the one of the parent first, like the MIPS one.
+//
+void CgenNode::code_c_routines(ostream& s)
+{
+  s << "static obj " << name << "_new(void)" << endl << "{" << endl;
+  if (name == Int)
+    s << "  return cool_box_int(0);" << endl;
+  else if (name == Bool)
+    s << "  return cool_box_bool(0);" << endl;
+  else if (name == Str)
+    s << "  return " << empty_string() << ";" << endl;
+  else {
+    s << "  struct " << name << " *self = cool_alloc(sizeof(struct " << name << "));" << endl
+      << "  ((struct Object *) self)->cls = (const struct cool_class *) &" << name << "_vtab;" << endl;
+    for (unsigned i = 0; i < attributes.size(); i++)
+      if (attributes[i]->type_decl == Str)
+        s << "  " << attribute_ref(this, attributes[i]->name, "self") << " = "
+          << empty_string() << ";" << endl;
+    s << "  " << name << "_init((obj) self);" << endl
+      << "  return (obj) self;" << endl;
+  }
+  s << "}" << endl << endl;
+  if (name == Int || name == Bool || name == Str)
+    return;
+
+  CContext init(class_table, this);
+  s << "static void " << name << "_init(obj self)" << endl << "{" << endl;
+  if (parent != No_class)
+    s << "  " << parent << "_init(self);" << endl;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isMethod() || ((attr_class *) f)->init->is_empty())
+      continue;
+    attr_class *a = (attr_class *) f;
+    std::string value = a->init->code_c(s, init);
+    s << init.indent() << init.var(a->name) << " = "
+      << convert(value, a->init->get_type(), a->type_decl) << ";" << endl;
+  }
+  s << "}" << endl << endl;
+  if (basic())
+    return;
+
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    if (!features->nth(i)->isMethod())
+      continue;
+    method_class *m = (method_class *) features->nth(i);
+    CContext ctx(class_table, this);
+    Formals fs = m->formals;
+    for (int j = fs->first(); fs->more(j); j = fs->next(j))
+      ctx.bind(((formal_class *) fs->nth(j))->name, ((formal_class *) fs->nth(j))->type_decl);
+
+    s << "static " << c_method(m, str(name) + "__" + str(m->name), TRUE) << endl << "{" << endl;
+    std::string value = m->expr->code_c(s, ctx);
+    s << "  return " << convert(value, m->expr->get_type(), m->return_type) << ";" << endl
+      << "}" << endl << endl;
+  }
+}
+
+//
+// The parts of the program come in the order C needs them; the
+// dispatch tables and the string constants refer to each other, so
+// the tables are declared before the constants and defined after.
+//
+void CgenClassTable::code_c()
+{
+  str << "/* Generated by cgen -C; link with c-runtime.c */" << endl << endl
+      << "#include \"c-runtime.h\"" << endl << endl;
+
+  if (cgen_debug) cout << "coding class structs" << endl;
+  for (unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_c_struct(str);
+  for (unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_c_vtable_type(str);
+  for (unsigned i = 0; i < classes_by_tag.size(); i++) {
+    Symbol name = classes_by_tag[i]->get_name();
+    str << "static const struct " << name << "_vtab " << name << "_vtab;" << endl;
+  }
+  str << endl;
+
+  if (cgen_debug) cout << "coding constants" << endl;
+  stringtable.add_string("");
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i)) {
+    StringEntry *e = stringtable.lookup(i);
+    string_numbers[e] = i;
+    str << "static struct String str_" << i
+        << " = { { (const struct cool_class *) &String_vtab }, " << e->get_len() << ", "
+        << c_string(e->get_string(), e->get_len()) << " };" << endl;
+  }
+  str << endl;
+
+  for (unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_c_prototypes(str);
+  str << endl;
+
+  if (cgen_debug) cout << "coding dispatch tables" << endl;
+  for (unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_c_vtable(str);
+  str << endl
+      << "const struct cool_class *const cool_int_class = (const struct cool_class *) &Int_vtab;" << endl
+      << "const struct cool_class *const cool_bool_class = (const struct cool_class *) &Bool_vtab;" << endl
+      << "const struct cool_class *const cool_string_class = (const struct cool_class *) &String_vtab;" << endl
+      << endl;
+
+  CgenNodeP owner;
+  find_method(probe(Main), main_meth, &owner);
+  str << "void cool_main(void)" << endl << "{" << endl
+      << "  " << owner->get_name() << "__" << main_meth << "(Main_new());" << endl
+      << "}" << endl << endl;
+
+  if (cgen_debug) cout << "coding constructors and methods" << endl;
+  for (unsigned i = 0; i < classes_by_tag.size(); i++)
+    classes_by_tag[i]->code_c_routines(str);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// Expressions
+//
+// code_c writes the statements computing an expression and returns the
+// C expression of its value: a temporary, a constant or self.
+//
+///////////////////////////////////////////////////////////////////////
+
+// The class a static type stands for in the class being written
+static CgenNodeP static_class(Symbol type, CContext& ctx)
+{
+  if (type == SELF_TYPE)
+    return ctx.get_class();
+  return ctx.get_table()->probe(type);
+}
+
+// The file and line of an expression, for the runtime errors
+static std::string position(tree_node *e, CContext& ctx)
+{
+  Symbol filename = ctx.get_class()->get_filename();
+  return c_string(filename->get_string(), filename->get_len()) + ", " + str(e->get_line_number());
+}
+
+// Semant gives the assignment the type of the variable
+std::string assign_class::code_c(ostream &s, CContext& ctx) {
+  std::string value = expr->code_c(s, ctx);
+  std::string result = ctx.temp(type, convert(value, expr->get_type(), type), s);
+  s << ctx.indent() << ctx.var(name) << " = "
+    << convert(result, type, ctx.var_type(name)) << ";" << endl;
+  return result;
+}
+
+//
+// As in the MIPS code, the arguments are evaluated first, then the
+// receiver, which is checked for void.  Static dispatch calls the
+// method of the named class directly; otherwise the call goes through
+// the dispatch table of the object, seen as the one of its static
+// class.
+//
+static std::string code_c_dispatch(Expression e, Expression receiver, Symbol static_type,
+                                   Symbol meth, Expressions actual, std::vector<int>& receivers,
+                                   CContext& ctx, ostream& s)
+{
+  CgenNodeP nd = static_class(static_type ? static_type : receiver->get_type(), ctx);
+  CgenNodeP owner;
+  method_class *m = find_method(nd, meth, &owner);
+
+  std::string args;
+  Formals formals = m->formals;
+  for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    std::string value = actual->nth(i)->code_c(s, ctx);
+    Symbol type = ((formal_class *) formals->nth(i))->type_decl;
+    args += ", " + convert(value, actual->nth(i)->get_type(), type);
+  }
+
+  std::string object = receiver->code_c(s, ctx);
+  if (unboxed(receiver->get_type()))
+    object = ctx.temp(Object, convert(object, receiver->get_type(), Object), s);
+  else if (may_be_void(object))
+    s << ctx.indent() << "if (" << object << " == NULL)" << endl
+      << ctx.indent() << "  cool_dispatch_abort(" << position(e, ctx) << ");" << endl;
+
+  // With -O a method that all the classes the receiver may have share
+  // is called directly
+  Symbol target = static_type != NULL ? owner->get_name() : NULL;
+  if (static_type == NULL && cgen_optimize)
+    target = ctx.get_table()->dispatch_target(nd, meth, receivers);
+  std::string call;
+  if (target != NULL)
+    call = str(target) + "__" + str(meth) + "(" + object + args + ")";
+  else
+    call = "((const struct " + str(slot_class(nd, meth)->get_name()) + "_vtab *) "
+      + object + "->cls)->m_"
+      + str(meth) + "(" + object + args + ")";
+
+  Symbol returned = m->return_type == SELF_TYPE ? Object : m->return_type;
+  return ctx.temp(e->get_type(), convert(call, returned, e->get_type()), s);
+}
+
+std::string static_dispatch_class::code_c(ostream &s, CContext& ctx) {
+  std::vector<int> none;
+  return code_c_dispatch(this, expr, type_name, name, actual, none, ctx, s);
+}
+
+std::string dispatch_class::code_c(ostream &s, CContext& ctx) {
+  return code_c_dispatch(this, expr, NULL, name, actual, receivers, ctx, s);
+}
+
+std::string cond_class::code_c(ostream &s, CContext& ctx) {
+  std::string p = pred->code_c(s, ctx);
+  std::string result = ctx.declare(type, s);
+
+  ctx.open("if (" + p + ")", s);
+  std::string value = then_exp->code_c(s, ctx);
+  s << ctx.indent() << result << " = " << convert(value, then_exp->get_type(), type) << ";" << endl;
+  ctx.close(s);
+  ctx.open("else", s);
+  value = else_exp->code_c(s, ctx);
+  s << ctx.indent() << result << " = " << convert(value, else_exp->get_type(), type) << ";" << endl;
+  ctx.close(s);
+  return result;
+}
+
+std::string loop_class::code_c(ostream &s, CContext& ctx) {
+  ctx.open("for (;;)", s);
+  std::string p = pred->code_c(s, ctx);
+  s << ctx.indent() << "if (!" << p << ")" << endl
+    << ctx.indent() << "  break;" << endl;
+  body->code_c(s, ctx);
+  ctx.close(s);
+
+  // The value of a loop is void
+  return "NULL";
+}
+
+//
+// The branches are tried from the highest tag down, each with a range
+// check on the tag of the object, as in the MIPS code.
+//
+std::string typcase_class::code_c(ostream &s, CContext& ctx) {
+  std::string value = expr->code_c(s, ctx);
+  std::string object = ctx.temp(Object, convert(value, expr->get_type(), Object), s);
+  s << ctx.indent() << "if (" << object << " == NULL)" << endl
+    << ctx.indent() << "  cool_case_abort2(" << position(this, ctx) << ");" << endl;
+
+  CgenClassTableP table = ctx.get_table();
+  std::vector<branch_class *> branches;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = (branch_class *) cases->nth(i);
+    unsigned j = branches.size();
+    int tag = table->probe(b->type_decl)->get_tag();
+    while (j > 0 && table->probe(branches[j - 1]->type_decl)->get_tag() < tag)
+      j--;
+    branches.insert(branches.begin() + j, b);
+  }
+
+  std::string result = ctx.declare(type, s);
+  std::string tag = ctx.temp(Int, object + "->cls->tag", s);
+  for (unsigned i = 0; i < branches.size(); i++) {
+    branch_class *b = branches[i];
+    CgenNodeP nd = table->probe(b->type_decl);
+    ctx.open(std::string(i == 0 ? "if" : "else if") + " (" + tag + " >= " + str(nd->get_tag())
+             + " && " + tag + " <= " + str(nd->get_max_tag()) + ")", s);
+    s << ctx.indent() << c_type(b->type_decl) << " v_" << b->name << " = "
+      << convert(object, Object, b->type_decl) << ";" << endl;
+    ctx.enterscope();
+    ctx.bind(b->name, b->type_decl);
+    std::string v = b->expr->code_c(s, ctx);
+    s << ctx.indent() << result << " = " << convert(v, b->expr->get_type(), type) << ";" << endl;
+    ctx.exitscope();
+    ctx.close(s);
+  }
+  s << ctx.indent() << "else" << endl
+    << ctx.indent() << "  cool_case_abort(" << object << ");" << endl;
+  return result;
+}
+
+std::string block_class::code_c(ostream &s, CContext& ctx) {
+  std::string value;
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    value = body->nth(i)->code_c(s, ctx);
+  return value;
+}
+
+//
+// The variable gets its own C block.  The initial value is computed
+// before the variable is declared, so it still sees any outer
+// variable of the same name.
+//
+std::string let_class::code_c(ostream &s, CContext& ctx) {
+  std::string result = ctx.declare(type, s);
+  ctx.open("", s);
+  std::string value = default_value(type_decl);
+  if (!init->is_empty())
+    value = convert(init->code_c(s, ctx), init->get_type(), type_decl);
+  s << ctx.indent() << c_type(type_decl) << " v_" << identifier << " = " << value << ";" << endl;
+
+  ctx.enterscope();
+  ctx.bind(identifier, type_decl);
+  value = body->code_c(s, ctx);
+  s << ctx.indent() << result << " = " << convert(value, body->get_type(), type) << ";" << endl;
+  ctx.exitscope();
+  ctx.close(s);
+  return result;
+}
+
+// Signed overflow is undefined in C, so the sums wrap in unsigned
+static std::string code_c_arith(Expression e1, Expression e2, char op,
+                                CContext& ctx, ostream& s)
+{
+  std::string a = e1->code_c(s, ctx);
+  std::string b = e2->code_c(s, ctx);
+  if (op == '/')
+    return ctx.temp(Int, "cool_div(" + a + ", " + b + ")", s);
+  return ctx.temp(Int, "(int32_t) ((uint32_t) " + a + " " + op + " (uint32_t) " + b + ")", s);
+}
+
+std::string plus_class::code_c(ostream &s, CContext& ctx) {
+  return code_c_arith(e1, e2, '+', ctx, s);
+}
+
+std::string sub_class::code_c(ostream &s, CContext& ctx) {
+  return code_c_arith(e1, e2, '-', ctx, s);
+}
+
+std::string mul_class::code_c(ostream &s, CContext& ctx) {
+  return code_c_arith(e1, e2, '*', ctx, s);
+}
+
+std::string divide_class::code_c(ostream &s, CContext& ctx) {
+  return code_c_arith(e1, e2, '/', ctx, s);
+}
+
+std::string neg_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  return ctx.temp(Int, "(int32_t) (0u - (uint32_t) " + a + ")", s);
+}
+
+std::string lt_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  std::string b = e2->code_c(s, ctx);
+  return ctx.temp(Bool, a + " < " + b, s);
+}
+
+// Objects are equal when identical, or equal Ints, Bools or Strings
+std::string eq_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  std::string b = e2->code_c(s, ctx);
+  if (unboxed(e1->get_type()))
+    return ctx.temp(Bool, a + " == " + b, s);
+  return ctx.temp(Bool, "cool_equal(" + a + ", " + b + ")", s);
+}
+
+std::string leq_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  std::string b = e2->code_c(s, ctx);
+  return ctx.temp(Bool, a + " <= " + b, s);
+}
+
+std::string comp_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  return ctx.temp(Bool, "!" + a, s);
+}
+
+// Literals too large for 32 bits wrap around, as in the MIPS .word
+std::string int_const_class::code_c(ostream& s, CContext& ctx)
+{
+  int32_t value = (int32_t) strtoll(token->get_string(), NULL, 10);
+  if (value == -2147483647 - 1)
+    return "INT32_MIN";
+  return str(value);
+}
+
+std::string string_const_class::code_c(ostream& s, CContext& ctx)
+{
+  return string_ref(token);
+}
+
+std::string bool_const_class::code_c(ostream& s, CContext& ctx)
+{
+  return val ? "1" : "0";
+}
+
+std::string new__class::code_c(ostream &s, CContext& ctx) {
+  if (type_name == SELF_TYPE)
+    return ctx.temp(SELF_TYPE, "self->cls->make()", s);
+  if (unboxed(type_name) || type_name == Str)
+    return default_value(type_name);
+  return ctx.temp(type_name, str(type_name) + "_new()", s);
+}
+
+std::string isvoid_class::code_c(ostream &s, CContext& ctx) {
+  std::string a = e1->code_c(s, ctx);
+  if (unboxed(e1->get_type()))
+    return "0";
+  return ctx.temp(Bool, a + " == NULL", s);
+}
+
+std::string no_expr_class::code_c(ostream &s, CContext& ctx) {
+  return "NULL";
+}
+
+// A copy, since the variable may change before the value is used
+std::string object_class::code_c(ostream &s, CContext& ctx) {
+  if (name == self)
+    return "self";
+  return ctx.temp(ctx.var_type(name), ctx.var(name), s);
+}
@@ -5,6 +5,8 @@
 #define COOL_TREE_HANDCODE_H
 
 #include <iostream>
+#include <string>
+#include <vector>
 #include "tree.h"
 #include "cool.h"
 #include "stringtab.h"
@@ -32,6 +34,10 @@ class Expression_class;
 typedef Expression_class *Expression;
 class Case_class;
 typedef Case_class *Case;
+class CgenContext;
+class CContext;
+class ConstEnv;
+class Receivers;
 
 typedef list_node<Class_> Classes_class;
 typedef Classes_class *Classes;
@@ -96,14 +102,42 @@ void dump_with_types(ostream& ,int);
 Symbol type;                                 \
 Symbol get_type() { return type; }           \
 Expression set_type(Symbol s) { type = s; return this; } \
-virtual void code(ostream&) = 0; \
+virtual void code(ostream&, CgenContext&) = 0; \
+virtual std::string code_c(ostream&, CContext&) = 0; \
+virtual Expression fold(ConstEnv&) = 0;      \
+virtual int assigns(Symbol) = 0;             \
+virtual void reach(Receivers&) = 0;          \
+virtual int size() = 0;                      \
+virtual int is_empty() { return 0; }         \
+virtual int is_const() { return 0; }         \
 virtual void dump_with_types(ostream&,int) = 0;  \
 void dump_type(ostream&, int);               \
 Expression_class() { type = (Symbol) NULL; }
 
 #define Expression_SHARED_EXTRAS           \
-void code(ostream&); 			   \
+void code(ostream&, CgenContext&);	   \
+std::string code_c(ostream&, CContext&);   \
+Expression fold(ConstEnv&);                \
+int assigns(Symbol);                       \
+void reach(Receivers&);                    \
+int size();                                \
 void dump_with_types(ostream&,int); 
 
+// Tags of the classes the receiver may have, from the analysis of -O
+#define dispatch_EXTRAS                    \
+std::vector<int> receivers;
+
+#define no_expr_EXTRAS                     \
+int is_empty() { return 1; }
+
+#define int_const_EXTRAS                   \
+int is_const() { return 1; }
+
+#define bool_const_EXTRAS                  \
+int is_const() { return 1; }
+
+#define string_const_EXTRAS                \
+int is_const() { return 1; }
+
 
 #endif
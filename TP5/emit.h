@@ -80,6 +80,7 @@
 //
 #define JALR  "\tjalr\t"  
 #define JAL   "\tjal\t"                 
+#define JR    "\tjr\t"
 #define RET   "\tjr\t"RA"\t"
 
 #define SW    "\tsw\t"
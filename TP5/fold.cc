@@ -0,0 +1,390 @@
+//////////////////////////////////////////////////////////////////////
+//
+// fold.cc
+//
+// Constant folding on the typed AST, run with -O before any code is
+// generated, so that all three backends see the result:
+//
+//    arithmetic    +, -, *, / and ~ on Int constants, wrapping around
+//                  at 32 bits like the MIPS instructions; a division
+//                  by a constant zero is left for run time
+//    comparisons   <, <=, = and not on constants
+//    let           a variable initialized with a constant of its own
+//                  type and never assigned is replaced by the constant
+//    if, while     a constant predicate selects the branch, or drops
+//                  the body of a loop that never runs
+//    blocks        constants whose value is thrown away are dropped
+//
+// Every fold method returns the expression that takes the place of
+// the node, which is the node itself when nothing changes.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "cgen.h"
+
+extern Symbol Bool, Int, Str, self;
+
+static int is_int(Expression e) { return e->is_const() && e->get_type() == Int; }
+
+static int is_bool(Expression e) { return e->is_const() && e->get_type() == Bool; }
+
+static int is_string(Expression e) { return e->is_const() && e->get_type() == Str; }
+
+static int32_t int_value(Expression e)
+{
+  return (int32_t) strtoll(((int_const_class *) e)->token->get_string(), NULL, 10);
+}
+
+static int bool_value(Expression e) { return ((bool_const_class *) e)->val; }
+
+//
+// New constants take the line of the expression they replace.  Int
+// constants go in the table now, before the code generator emits it.
+//
+static Expression make_int(int32_t v, Expression old)
+{
+  char buf[16];
+  sprintf(buf, "%d", v);
+  Expression e = int_const(inttable.add_string(buf));
+  e->set(old);
+  return e->set_type(Int);
+}
+
+static Expression make_bool(int v, Expression old)
+{
+  Expression e = bool_const(v);
+  e->set(old);
+  return e->set_type(Bool);
+}
+
+static int32_t wrap(int64_t v) { return (int32_t) (uint32_t) v; }
+
+static Expressions fold_list(Expressions es, ConstEnv& env)
+{
+  Expressions folded = nil_Expressions();
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    folded = append_Expressions(folded, single_Expressions(es->nth(i)->fold(env)));
+  return folded;
+}
+
+static int list_assigns(Expressions es, Symbol name)
+{
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    if (es->nth(i)->assigns(name))
+      return TRUE;
+  return FALSE;
+}
+
+void fold_constants(Classes classes)
+{
+  for (int i = classes->first(); classes->more(i); i = classes->next(i)) {
+    Features features = ((class__class *) classes->nth(i))->features;
+    for (int j = features->first(); features->more(j); j = features->next(j)) {
+      ConstEnv env;
+      env.enterscope();
+      if (features->nth(j)->isMethod()) {
+        method_class *m = (method_class *) features->nth(j);
+        for (int k = m->formals->first(); m->formals->more(k); k = m->formals->next(k))
+          env.addid(((formal_class *) m->formals->nth(k))->name, NULL);
+        m->expr = m->expr->fold(env);
+      } else {
+        attr_class *a = (attr_class *) features->nth(j);
+        a->init = a->init->fold(env);
+      }
+      env.exitscope();
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// fold
+//
+///////////////////////////////////////////////////////////////////////
+
+Expression assign_class::fold(ConstEnv& env)
+{
+  expr = expr->fold(env);
+  return this;
+}
+
+Expression static_dispatch_class::fold(ConstEnv& env)
+{
+  expr = expr->fold(env);
+  actual = fold_list(actual, env);
+  return this;
+}
+
+Expression dispatch_class::fold(ConstEnv& env)
+{
+  expr = expr->fold(env);
+  actual = fold_list(actual, env);
+  return this;
+}
+
+Expression cond_class::fold(ConstEnv& env)
+{
+  pred = pred->fold(env);
+  then_exp = then_exp->fold(env);
+  else_exp = else_exp->fold(env);
+  if (is_bool(pred))
+    return bool_value(pred) ? then_exp : else_exp;
+  return this;
+}
+
+Expression loop_class::fold(ConstEnv& env)
+{
+  pred = pred->fold(env);
+  if (is_bool(pred) && !bool_value(pred))
+    body = no_expr();
+  else
+    body = body->fold(env);
+  return this;
+}
+
+Expression typcase_class::fold(ConstEnv& env)
+{
+  expr = expr->fold(env);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = (branch_class *) cases->nth(i);
+    env.enterscope();
+    env.addid(b->name, NULL);
+    b->expr = b->expr->fold(env);
+    env.exitscope();
+  }
+  return this;
+}
+
+Expression block_class::fold(ConstEnv& env)
+{
+  Expressions folded = nil_Expressions();
+  Expression last = NULL;
+  int n = 0;
+  for (int i = body->first(); body->more(i); i = body->next(i)) {
+    Expression e = body->nth(i)->fold(env);
+    if (!body->more(body->next(i)) || !e->is_const()) {
+      folded = append_Expressions(folded, single_Expressions(e));
+      last = e;
+      n++;
+    }
+  }
+  if (n == 1)
+    return last;
+  body = folded;
+  return this;
+}
+
+Expression let_class::fold(ConstEnv& env)
+{
+  init = init->fold(env);
+  int propagate = init->is_const() && init->get_type() == type_decl &&
+                  !body->assigns(identifier);
+  env.enterscope();
+  env.addid(identifier, propagate ? init : NULL);
+  body = body->fold(env);
+  env.exitscope();
+  return propagate ? body : this;
+}
+
+Expression plus_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_int(wrap((int64_t) int_value(e1) + int_value(e2)), this);
+  return this;
+}
+
+Expression sub_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_int(wrap((int64_t) int_value(e1) - int_value(e2)), this);
+  return this;
+}
+
+Expression mul_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_int(wrap((int64_t) int_value(e1) * int_value(e2)), this);
+  return this;
+}
+
+//
+// x / 0 has to raise the error when the program runs, and the only
+// quotient that overflows, INT_MIN / -1, wraps around to INT_MIN.
+//
+Expression divide_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2) && int_value(e2) != 0) {
+    if (int_value(e2) == -1)
+      return make_int(wrap(-(int64_t) int_value(e1)), this);
+    return make_int(int_value(e1) / int_value(e2), this);
+  }
+  return this;
+}
+
+Expression neg_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  if (is_int(e1))
+    return make_int(wrap(-(int64_t) int_value(e1)), this);
+  return this;
+}
+
+Expression lt_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_bool(int_value(e1) < int_value(e2), this);
+  return this;
+}
+
+//
+// String constants are equal when they are the same entry of the
+// string table.
+//
+Expression eq_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_bool(int_value(e1) == int_value(e2), this);
+  if (is_bool(e1) && is_bool(e2))
+    return make_bool(bool_value(e1) == bool_value(e2), this);
+  if (is_string(e1) && is_string(e2))
+    return make_bool(((string_const_class *) e1)->token == ((string_const_class *) e2)->token, this);
+  return this;
+}
+
+Expression leq_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  e2 = e2->fold(env);
+  if (is_int(e1) && is_int(e2))
+    return make_bool(int_value(e1) <= int_value(e2), this);
+  return this;
+}
+
+Expression comp_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  if (is_bool(e1))
+    return make_bool(!bool_value(e1), this);
+  return this;
+}
+
+Expression int_const_class::fold(ConstEnv& env) { return this; }
+
+Expression bool_const_class::fold(ConstEnv& env) { return this; }
+
+Expression string_const_class::fold(ConstEnv& env) { return this; }
+
+Expression new__class::fold(ConstEnv& env) { return this; }
+
+// A constant is never void
+Expression isvoid_class::fold(ConstEnv& env)
+{
+  e1 = e1->fold(env);
+  if (e1->is_const())
+    return make_bool(FALSE, this);
+  return this;
+}
+
+Expression no_expr_class::fold(ConstEnv& env) { return this; }
+
+Expression object_class::fold(ConstEnv& env)
+{
+  Expression value = name == self ? NULL : env.lookup(name);
+  if (value == NULL)
+    return this;
+  Expression e = value->copy_Expression();
+  e->set(this);
+  return e->set_type(value->get_type());
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// assigns: whether the expression contains an assignment to `name'
+// that is not hidden by a nested binding of the same name
+//
+///////////////////////////////////////////////////////////////////////
+
+int assign_class::assigns(Symbol n) { return name == n || expr->assigns(n); }
+
+int static_dispatch_class::assigns(Symbol n)
+{
+  return expr->assigns(n) || list_assigns(actual, n);
+}
+
+int dispatch_class::assigns(Symbol n)
+{
+  return expr->assigns(n) || list_assigns(actual, n);
+}
+
+int cond_class::assigns(Symbol n)
+{
+  return pred->assigns(n) || then_exp->assigns(n) || else_exp->assigns(n);
+}
+
+int loop_class::assigns(Symbol n) { return pred->assigns(n) || body->assigns(n); }
+
+int typcase_class::assigns(Symbol n)
+{
+  if (expr->assigns(n))
+    return TRUE;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = (branch_class *) cases->nth(i);
+    if (b->name != n && b->expr->assigns(n))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+int block_class::assigns(Symbol n) { return list_assigns(body, n); }
+
+int let_class::assigns(Symbol n)
+{
+  return init->assigns(n) || (identifier != n && body->assigns(n));
+}
+
+int plus_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int sub_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int mul_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int divide_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int neg_class::assigns(Symbol n) { return e1->assigns(n); }
+
+int lt_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int eq_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int leq_class::assigns(Symbol n) { return e1->assigns(n) || e2->assigns(n); }
+
+int comp_class::assigns(Symbol n) { return e1->assigns(n); }
+
+int int_const_class::assigns(Symbol n) { return FALSE; }
+
+int bool_const_class::assigns(Symbol n) { return FALSE; }
+
+int string_const_class::assigns(Symbol n) { return FALSE; }
+
+int new__class::assigns(Symbol n) { return FALSE; }
+
+int isvoid_class::assigns(Symbol n) { return e1->assigns(n); }
+
+int no_expr_class::assigns(Symbol n) { return FALSE; }
+
+int object_class::assigns(Symbol n) { return FALSE; }
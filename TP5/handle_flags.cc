@@ -30,6 +30,15 @@ extern int cool_yydebug;        // for the parser
        bool disable_reg_alloc;  // Don't do register allocation
 
        int cgen_optimize;       // optimize switch for code generator 
+       int semant_jobs;         // threads used to check classes (0 = sequential)
+       char *semant_cache_dir;  // where checked methods are cached, if anywhere
+       int semant_reachable;    // only check code reachable from Main.main
+       char *semant_interface_dir;  // where interface summaries are written, if anywhere
+       char **semant_interfaces;    // interface summaries loaded instead of their sources
+       int semant_interface_count;
+       int semant_json_errors;  // print semantic errors as JSON, one per line
+       int cgen_native;         // generate x86-64 assembly instead of MIPS
+       int cgen_emit_c;         // generate C instead of MIPS
        char *out_filename;      // file name for generated code
        Memmgr cgen_Memmgr = GC_NOGC;      // enable/disable garbage collection
        Memmgr_Test cgen_Memmgr_Test = GC_NORMAL;  // normal/test GC
@@ -51,9 +60,18 @@ void handle_flags(int argc, char *argv[]) {
   cgen_debug = 0;
   cgen_optimize = 0;
   disable_reg_alloc = 0;
+  semant_jobs = 0;
+  semant_cache_dir = NULL;
+  semant_reachable = 0;
+  semant_interface_dir = NULL;
+  semant_interfaces = NULL;
+  semant_interface_count = 0;
+  semant_json_errors = 0;
+  cgen_native = 0;
+  cgen_emit_c = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrOo:gtTj:i:ue:x:mnC")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
@@ -99,6 +117,32 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'j':  // check classes on this many threads
+      semant_jobs = atoi(optarg);
+      break;
+    case 'i':  // reuse the results of methods checked in earlier runs
+      semant_cache_dir = optarg;
+      break;
+    case 'u':  // skip the bodies of code Main.main can't reach
+      semant_reachable = 1;
+      break;
+    case 'e':  // write the interface of every file checked
+      semant_interface_dir = optarg;
+      break;
+    case 'x':  // use an interface summary in place of its source
+      semant_interfaces = (char **) realloc(semant_interfaces,
+                                            (semant_interface_count + 1) * sizeof(char *));
+      semant_interfaces[semant_interface_count++] = optarg;
+      break;
+    case 'm':  // machine-readable semantic errors
+      semant_json_errors = 1;
+      break;
+    case 'n':  // native code for x86-64 Linux
+      cgen_native = 1;
+      break;
+    case 'C':  // C source, for the system C compiler
+      cgen_emit_c = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +155,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscOgtTrumnC -o outname -j jobs -i cachedir -e interfacedir -x interface] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-OgtTumnC -o outname -j jobs -i cachedir -e interfacedir -x interface] [input-files]\n";
 #endif
       exit(1);
   }
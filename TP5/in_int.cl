@@ -0,0 +1,22 @@
+(*  Reads integers from the input, one per line, and prints each of
+    them with the running sum, until a 0.  The line after the 0 is read
+    as a string.  The native executables must print what spim does.
+ *)
+
+class Main inherits IO {
+  sum : Int;
+
+  main() : Object {
+    let n : Int <- in_int() in
+      {
+        while not n = 0 loop
+          {
+            sum <- sum + n;
+            out_int(n).out_string(" ").out_int(sum).out_string("\n");
+            n <- in_int();
+          }
+        pool;
+        out_string(in_string()).out_string("\n");
+      }
+  };
+};
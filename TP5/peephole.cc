@@ -0,0 +1,442 @@
+//////////////////////////////////////////////////////////////////////
+//
+// peephole.cc
+//
+// The instruction list of a routine and the peephole optimizer that
+// runs over it with -O.  The rules only look at short windows of
+// straight-line code:
+//
+//    push/pop      a value pushed and popped with nothing in between
+//                  looking at the stack
+//    load/store    a load of the word that was just stored
+//    jump to next  a branch to the label right after it
+//    branch chain  a branch to a label whose code is an unconditional
+//                  branch goes straight to the final target
+//    dead move     a move to itself, or to a register the next
+//                  instruction overwrites without reading
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <set>
+#include "cgen.h"
+
+enum Rule { PushPop, LoadStore, JumpNext, BranchChain, DeadMove, NRULES };
+
+static const char *rule_names[NRULES] =
+  { "push/pop pairs", "loads after stores", "jumps to next", "branch chains", "dead moves" };
+
+static int removed[NRULES];     // instructions removed by each rule
+static int rewritten[NRULES];   // instructions changed in place
+
+///////////////////////////////////////////////////////////////////////
+//
+// CodeBuffer
+//
+///////////////////////////////////////////////////////////////////////
+
+int CodeBuffer::overflow(int c)
+{
+  if (c == EOF)
+    return 0;
+  if (c == '\n')
+    add_line();
+  else
+    line += (char) c;
+  return c;
+}
+
+//
+// Splits a line of assembly into an Instr.  Blank lines give nothing.
+//
+bool parse_instr(const std::string& line, Instr& in)
+{
+  std::vector<std::string> words;
+  std::string word;
+  for (unsigned i = 0; i <= line.size(); i++)
+    {
+      if (i == line.size() || line[i] == ' ' || line[i] == '\t')
+	{
+	  if (!word.empty())
+	    words.push_back(word);
+	  word.clear();
+	}
+      else
+	word += line[i];
+    }
+  if (words.empty())
+    return false;
+
+  in.label.clear();
+  in.args.clear();
+  if (line[0] != '\t' && words.size() == 1 && words[0][words[0].size() - 1] == ':')
+    {
+      in.label = words[0].substr(0, words[0].size() - 1);
+      in.op.clear();
+    }
+  else
+    {
+      in.op = words[0];
+      in.args.assign(words.begin() + 1, words.end());
+    }
+  return true;
+}
+
+void CodeBuffer::add_line()
+{
+  Instr in;
+  if (parse_instr(line, in))
+    code.push_back(in);
+  line.clear();
+}
+
+void CodeBuffer::print(ostream& s)
+{
+  for (unsigned i = 0; i < code.size(); i++)
+    {
+      if (!code[i].label.empty())
+	{
+	  s << code[i].label << ":" << endl;
+	  continue;
+	}
+      s << "\t" << code[i].op;
+      for (unsigned j = 0; j < code[i].args.size(); j++)
+	s << (j == 0 ? "\t" : " ") << code[i].args[j];
+      s << endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// What an instruction does with registers and control
+//
+///////////////////////////////////////////////////////////////////////
+
+static bool is_label(const Instr& in) { return !in.label.empty(); }
+
+static bool is_directive(const Instr& in) { return !is_label(in) && in.op[0] == '.'; }
+
+static bool is_branch(const Instr& in)
+{
+  static const char *ops[] =
+    { "b", "beq", "bne", "blt", "ble", "bgt", "bge", "beqz", "bnez", NULL };
+  for (int i = 0; ops[i]; i++)
+    if (in.op == ops[i])
+      return true;
+  return false;
+}
+
+static bool is_control(const Instr& in)
+{
+  return is_branch(in) || in.op == "j" || in.op == "jr" ||
+         in.op == "jal" || in.op == "jalr";
+}
+
+// Instructions whose first operand is the only register they write
+static bool is_computation(const Instr& in)
+{
+  static const char *ops[] =
+    { "lw", "li", "la", "move", "neg", "add", "addu", "addi", "addiu", "sub", "subu",
+      "mul", "div", "sll", "srl", "sra", "slt", "and", "or", "xor", NULL };
+  for (int i = 0; ops[i]; i++)
+    if (in.op == ops[i])
+      return true;
+  return false;
+}
+
+// The register named in an operand, including the base of "off(reg)"
+static std::string operand_reg(const std::string& arg)
+{
+  std::string::size_type open = arg.find('(');
+  if (open != std::string::npos)
+    return arg.substr(open + 1, arg.size() - open - 2);
+  return arg;
+}
+
+static bool mentions(const Instr& in, const std::string& reg)
+{
+  for (unsigned i = 0; i < in.args.size(); i++)
+    if (operand_reg(in.args[i]) == reg)
+      return true;
+  return false;
+}
+
+// Whether the instruction may read `reg'; anything unknown does
+static bool reads(const Instr& in, const std::string& reg)
+{
+  if (!is_computation(in))
+    return true;
+  for (unsigned i = 1; i < in.args.size(); i++)
+    if (operand_reg(in.args[i]) == reg)
+      return true;
+  return false;
+}
+
+static bool writes(const Instr& in, const std::string& reg)
+{
+  return is_computation(in) && in.args[0] == reg;
+}
+
+static bool is_straight_line(const Instr& in)
+{
+  return !is_label(in) && !is_directive(in) && !is_control(in);
+}
+
+static bool is_sp_adjust(const Instr& in, int words)
+{
+  char imm[16];
+  sprintf(imm, "%d", words * WORD_SIZE);
+  return in.op == "addiu" && in.args.size() == 3 &&
+         in.args[0] == SP && in.args[1] == SP && in.args[2] == imm;
+}
+
+static Instr make_move(const std::string& dest, const std::string& src)
+{
+  Instr in;
+  in.op = "move";
+  in.args.push_back(dest);
+  in.args.push_back(src);
+  return in;
+}
+
+// Drops the instructions marked dead
+static void compact(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  unsigned n = 0;
+  for (unsigned i = 0; i < code.size(); i++)
+    if (!dead[i])
+      code[n++] = code[i];
+  code.resize(n);
+  dead.assign(n, false);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// The rules
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// sw R 0($sp); addiu $sp $sp -4; ...; addiu $sp $sp 4
+//
+// The pushed word is never read if nothing in between uses $sp or $fp,
+// so the three stack instructions go.  When the pop loads the word back
+// with lw R2 4($sp), that becomes a move.
+//
+static bool push_pop(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  bool changed = false;
+  for (unsigned i = 0; i + 1 < code.size(); i++)
+    {
+      if (dead[i] || code[i].op != "sw" || code[i].args.size() != 2 ||
+	  code[i].args[1] != "0($sp)" || !is_sp_adjust(code[i + 1], -1))
+	continue;
+
+      std::string reg = code[i].args[0];
+      bool reg_written = false;
+      unsigned j = i + 2;
+      while (j < code.size() && is_straight_line(code[j]) && !dead[j] &&
+	     !mentions(code[j], SP) && !mentions(code[j], FP))
+	{
+	  if (writes(code[j], reg))
+	    reg_written = true;
+	  j++;
+	}
+      if (j >= code.size() || dead[j])
+	continue;
+
+      if (is_sp_adjust(code[j], 1))
+	{
+	  dead[i] = dead[i + 1] = dead[j] = true;
+	  removed[PushPop] += 3;
+	  changed = true;
+	}
+      else if (code[j].op == "lw" && code[j].args[1] == "4($sp)" &&
+	       j + 1 < code.size() && is_sp_adjust(code[j + 1], 1) && !reg_written)
+	{
+	  dead[i] = dead[i + 1] = dead[j + 1] = true;
+	  removed[PushPop] += 3;
+	  if (code[j].args[0] == reg)
+	    {
+	      dead[j] = true;
+	      removed[PushPop]++;
+	    }
+	  else
+	    {
+	      code[j] = make_move(code[j].args[0], reg);
+	      rewritten[PushPop]++;
+	    }
+	  changed = true;
+	}
+    }
+  return changed;
+}
+
+//
+// sw R off(B); lw R2 off(B)
+//
+// The load finds R in memory: it goes if R2 is R, else it becomes a move.
+//
+static bool load_store(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  bool changed = false;
+  for (unsigned i = 0; i + 1 < code.size(); i++)
+    {
+      if (dead[i] || dead[i + 1] || code[i].op != "sw" || code[i + 1].op != "lw" ||
+	  code[i].args[1] != code[i + 1].args[1])
+	continue;
+
+      if (code[i + 1].args[0] == code[i].args[0])
+	{
+	  dead[i + 1] = true;
+	  removed[LoadStore]++;
+	}
+      else
+	{
+	  code[i + 1] = make_move(code[i + 1].args[0], code[i].args[0]);
+	  rewritten[LoadStore]++;
+	}
+      changed = true;
+    }
+  return changed;
+}
+
+// A branch to one of the labels that directly follow it
+static bool jump_next(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  bool changed = false;
+  for (unsigned i = 0; i < code.size(); i++)
+    {
+      if (dead[i] || !is_branch(code[i]))
+	continue;
+      const std::string& target = code[i].args.back();
+      for (unsigned j = i + 1; j < code.size() && (is_label(code[j]) || dead[j]); j++)
+	if (!dead[j] && code[j].label == target)
+	  {
+	    dead[i] = true;
+	    removed[JumpNext]++;
+	    changed = true;
+	    break;
+	  }
+    }
+  return changed;
+}
+
+//
+// A branch to a label that is followed by "b L2" goes to L2 directly.
+// The intermediate branch stays, since it may still be reached by
+// falling into it.
+//
+static bool branch_chain(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  std::map<std::string, unsigned> labels;
+  for (unsigned i = 0; i < code.size(); i++)
+    if (!dead[i] && is_label(code[i]))
+      labels[code[i].label] = i;
+
+  bool changed = false;
+  for (unsigned i = 0; i < code.size(); i++)
+    {
+      if (dead[i] || !is_branch(code[i]))
+	continue;
+      std::map<std::string, unsigned>::iterator l = labels.find(code[i].args.back());
+      if (l == labels.end())
+	continue;
+
+      unsigned j = l->second;
+      while (j < code.size() && (dead[j] || is_label(code[j])))
+	j++;
+      if (j < code.size() && code[j].op == "b" && j != i &&
+	  code[j].args[0] != code[i].args.back())
+	{
+	  code[i].args.back() = code[j].args[0];
+	  rewritten[BranchChain]++;
+	  changed = true;
+	}
+    }
+  return changed;
+}
+
+static bool dead_move(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  bool changed = false;
+  for (unsigned i = 0; i < code.size(); i++)
+    {
+      if (dead[i] || code[i].op != "move")
+	continue;
+      const std::string& reg = code[i].args[0];
+      unsigned j = i + 1;
+      while (j < code.size() && dead[j])
+	j++;
+
+      if (code[i].args[1] == reg ||
+	  (j < code.size() && !is_label(code[j]) && writes(code[j], reg) &&
+	   !reads(code[j], reg)))
+	{
+	  dead[i] = true;
+	  removed[DeadMove]++;
+	  changed = true;
+	}
+    }
+  return changed;
+}
+
+//
+// Labels that nothing refers to anymore are dropped, so that the code
+// around them can be joined by the other rules.  Only the local labels
+// of the code generator are candidates.
+//
+static void drop_unused_labels(std::vector<Instr>& code, std::vector<bool>& dead)
+{
+  std::set<std::string> used;
+  for (unsigned i = 0; i < code.size(); i++)
+    if (!dead[i] && !is_label(code[i]))
+      for (unsigned j = 0; j < code[i].args.size(); j++)
+	used.insert(code[i].args[j]);
+
+  for (unsigned i = 0; i < code.size(); i++)
+    if (is_label(code[i]) && strncmp(code[i].label.c_str(), "label", 5) == 0 &&
+	used.find(code[i].label) == used.end())
+      dead[i] = true;
+}
+
+//
+// The rules run until nothing changes, with a bound on the rounds in
+// case branches form a cycle.
+//
+#define MAX_ROUNDS 16
+
+void peephole(std::vector<Instr>& code)
+{
+  std::vector<bool> dead(code.size(), false);
+  bool changed = true;
+  for (int round = 0; changed && round < MAX_ROUNDS; round++)
+    {
+      changed = false;
+      changed |= push_pop(code, dead);
+      changed |= load_store(code, dead);
+      changed |= branch_chain(code, dead);
+      changed |= jump_next(code, dead);
+      changed |= dead_move(code, dead);
+      drop_unused_labels(code, dead);
+      compact(code, dead);
+    }
+}
+
+void print_peephole_stats(ostream& s)
+{
+  s << "# peephole optimizer:" << endl;
+  for (int r = 0; r < NRULES; r++)
+    {
+      s << "#   " << rule_names[r] << ": ";
+      if (r == BranchChain)
+	s << rewritten[r] << " retargeted";
+      else
+	{
+	  s << removed[r] << " removed";
+	  if (rewritten[r] > 0)
+	    s << ", " << rewritten[r] << " turned into moves";
+	}
+      s << endl;
+    }
+}
@@ -0,0 +1,222 @@
+//////////////////////////////////////////////////////////////////////
+//
+// receivers.cc
+//
+// Rapid type analysis of the typed AST, run with -O once the classes
+// are laid out.  A class is live when one of its objects may exist:
+// Int, Bool and String, which the runtime creates, Main, and every
+// class named by a `new' in code that may run.  Code may run when it
+// is Main.main, the initializer of an attribute of a live class, or a
+// method a call that may run may land on:
+//
+//    static dispatch    the method the named class has
+//    dispatch           the method each live class conforming to the
+//                       static type of the receiver has; SELF_TYPE
+//                       stands for the class defining the code
+//
+// Classes becoming live and calls being found both reach more code,
+// so the analysis goes on until neither finds anything new.  Then
+// every dispatch that may run gets the tags of the live classes
+// conforming to the static type of its receiver.  Dispatches that
+// never run keep no receivers.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "cgen.h"
+
+extern Symbol Bool, Int, Main, main_meth, No_class, SELF_TYPE, Str;
+
+static method_class *find_method(CgenNodeP nd, Symbol meth)
+{
+  Features fs = nd->features;
+  for (int i = fs->first(); fs->more(i); i = fs->next(i))
+    if (fs->nth(i)->isMethod() && fs->nth(i)->getName() == meth)
+      return (method_class *) fs->nth(i);
+  return NULL;
+}
+
+Receivers::Receivers(CgenClassTableP t)
+  : table(t), live(t->class_count(), FALSE), cls(NULL) { }
+
+// The code of feature `f' of class `c' may run
+void Receivers::follow(CgenNodeP c, Feature f, Expression e)
+{
+  if (reached.insert(f).second)
+    pending.push_back(std::make_pair(c, e));
+}
+
+void Receivers::reach_method(Symbol owner, Symbol meth)
+{
+  CgenNodeP nd = table->probe(owner);
+  method_class *m = find_method(nd, meth);
+  follow(nd, m, m->expr);
+}
+
+//
+// Objects of class `type' may exist: the initializers of their
+// attributes may run, and so may their methods for the calls found so
+// far on a receiver they conform to.
+//
+void Receivers::create(Symbol type)
+{
+  CgenNodeP nd = table->probe(type);
+  int tag = nd->get_tag();
+  if (live[tag])
+    return;
+  live[tag] = TRUE;
+
+  for (CgenNodeP a = nd; a != NULL && a->get_name() != No_class; a = a->get_parentnd()) {
+    Features fs = a->features;
+    for (int i = fs->first(); fs->more(i); i = fs->next(i))
+      if (!fs->nth(i)->isMethod())
+        follow(a, fs->nth(i), ((attr_class *) fs->nth(i))->init);
+  }
+
+  std::map<Symbol, std::vector<CgenNodeP> >::iterator it;
+  for (it = dispatched.begin(); it != dispatched.end(); it++)
+    for (unsigned i = 0; i < it->second.size(); i++)
+      if (it->second[i]->get_tag() <= tag && tag <= it->second[i]->get_max_tag()) {
+        reach_method(nd->method_owner(it->first), it->first);
+        break;
+      }
+}
+
+void Receivers::call(Symbol type, Symbol meth)
+{
+  reach_method(table->probe(type)->method_owner(meth), meth);
+}
+
+void Receivers::dispatch(dispatch_class *call)
+{
+  Symbol type = call->expr->get_type();
+  CgenNodeP nd = type == SELF_TYPE ? cls : table->probe(type);
+  sites.push_back(std::make_pair(call, nd));
+
+  std::vector<CgenNodeP>& seen = dispatched[call->name];
+  for (unsigned i = 0; i < seen.size(); i++)
+    if (seen[i] == nd)
+      return;
+  seen.push_back(nd);
+
+  for (int t = nd->get_tag(); t <= nd->get_max_tag(); t++)
+    if (live[t])
+      reach_method(table->class_by_tag(t)->method_owner(call->name), call->name);
+}
+
+void Receivers::run()
+{
+  create(Int);
+  create(Bool);
+  create(Str);
+  create(Main);
+  call(Main, main_meth);
+
+  while (!pending.empty()) {
+    cls = pending.back().first;
+    Expression e = pending.back().second;
+    pending.pop_back();
+    e->reach(*this);
+  }
+
+  for (unsigned i = 0; i < sites.size(); i++) {
+    CgenNodeP nd = sites[i].second;
+    std::vector<int>& receivers = sites[i].first->receivers;
+    receivers.clear();
+    for (int t = nd->get_tag(); t <= nd->get_max_tag(); t++)
+      if (live[t])
+        receivers.push_back(t);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// reach: records what the expression creates and calls
+//
+///////////////////////////////////////////////////////////////////////
+
+static void list_reach(Expressions es, Receivers& r)
+{
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    es->nth(i)->reach(r);
+}
+
+void assign_class::reach(Receivers& r) { expr->reach(r); }
+
+void static_dispatch_class::reach(Receivers& r)
+{
+  expr->reach(r);
+  list_reach(actual, r);
+  r.call(type_name, name);
+}
+
+void dispatch_class::reach(Receivers& r)
+{
+  expr->reach(r);
+  list_reach(actual, r);
+  r.dispatch(this);
+}
+
+void cond_class::reach(Receivers& r)
+{
+  pred->reach(r);
+  then_exp->reach(r);
+  else_exp->reach(r);
+}
+
+void loop_class::reach(Receivers& r)
+{
+  pred->reach(r);
+  body->reach(r);
+}
+
+void typcase_class::reach(Receivers& r)
+{
+  expr->reach(r);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    ((branch_class *) cases->nth(i))->expr->reach(r);
+}
+
+void block_class::reach(Receivers& r) { list_reach(body, r); }
+
+void let_class::reach(Receivers& r)
+{
+  init->reach(r);
+  body->reach(r);
+}
+
+void plus_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void sub_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void mul_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void divide_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void neg_class::reach(Receivers& r) { e1->reach(r); }
+
+void lt_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void eq_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void leq_class::reach(Receivers& r) { e1->reach(r); e2->reach(r); }
+
+void comp_class::reach(Receivers& r) { e1->reach(r); }
+
+void int_const_class::reach(Receivers& r) { }
+
+void bool_const_class::reach(Receivers& r) { }
+
+void string_const_class::reach(Receivers& r) { }
+
+// new SELF_TYPE makes an object of a class that is already live
+void new__class::reach(Receivers& r)
+{
+  if (type_name != SELF_TYPE)
+    r.create(type_name);
+}
+
+void isvoid_class::reach(Receivers& r) { e1->reach(r); }
+
+void no_expr_class::reach(Receivers& r) { }
+
+void object_class::reach(Receivers& r) { }
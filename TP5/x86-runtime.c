@@ -0,0 +1,360 @@
+/*
+ * x86-runtime.c
+ *
+ * The runtime system for the x86-64 code of cgen -n: the methods of
+ * Object, IO and String, equality_test, the error routines and the
+ * program start-up, with the behaviour of the MIPS trap handler.
+ * Link it with the generated assembly:
+ *
+ *    gcc -no-pie prog.s x86-runtime.c -o prog
+ *
+ * Cool values are 4-byte words, so the heap and the Cool stack are
+ * mapped in the low 2GB.  There is no garbage collector; the heap only
+ * grows.  The routines are entered from Cool code through small stubs
+ * that save the registers the generated code works with and call the
+ * C function on the Cool stack; see cool_runtime_call below.
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef uint32_t word;
+
+#define HEAP_SIZE  (256 * 1024 * 1024)
+#define STACK_SIZE (64 * 1024 * 1024)
+
+/* Objects: tag, size in words, dispatch table, attributes */
+#define TAG   0
+#define SIZE  1
+#define FIRST 3
+
+#define obj(p)   ((word *) (uintptr_t) (p))
+#define addr(p)  ((word) (uintptr_t) (p))
+
+/* Symbols of the generated code */
+extern word class_nameTab[];
+extern word Main_protObj[], Int_protObj[], String_protObj[];
+extern word _int_tag, _bool_tag, _string_tag;
+extern char Main_init[];
+extern char Main_main[] __asm__("Main.main");
+
+/* MIPS registers seen by the runtime, saved by cool_runtime_call */
+word rt_a0, rt_a1, rt_t1, rt_t2, rt_sp;
+
+/* The MIPS registers that have no x86 register (see x86.cc) */
+uint64_t cool_reg_ra, cool_reg_s7;
+uint64_t cool_reg_t4, cool_reg_t5, cool_reg_t6, cool_reg_t7, cool_reg_t8, cool_reg_t9;
+
+static char *heap;
+
+/* A word on the Cool stack: arg(1) is the last argument pushed */
+static word arg(int n) { return obj(rt_sp)[n]; }
+
+static void pop(int n) { rt_sp += 4 * n; }
+
+static void cool_exit(int status)
+{
+  fflush(stdout);
+  exit(status);
+}
+
+static word allocate(word words)
+{
+  *(int32_t *) heap = -1;                       /* eye catcher */
+  word o = addr(heap + 4);
+  heap += 4 * (words + 1);
+  return o;
+}
+
+static word copy(word o)
+{
+  if (o == 0)
+    {
+      printf("Copy of void object\n");
+      cool_exit(1);
+    }
+  word size = obj(o)[SIZE];
+  word c = allocate(size);
+  memcpy(obj(c), obj(o), 4 * size);
+  return c;
+}
+
+static word new_int(int32_t v)
+{
+  word o = copy(addr(Int_protObj));
+  obj(o)[FIRST] = v;
+  return o;
+}
+
+static word string_length(word s) { return obj(obj(s)[FIRST])[FIRST]; }
+
+static char *string_chars(word s) { return (char *) (obj(s) + FIRST + 1); }
+
+static word new_string(const char *chars, word n)
+{
+  word size = 5 + (n + 4) / 4;
+  word s = allocate(size);
+  memcpy(obj(s), String_protObj, 4 * 3);
+  obj(s)[SIZE] = size;
+  obj(s)[FIRST] = new_int(n);
+  memcpy(string_chars(s), chars, n);
+  string_chars(s)[n] = 0;
+  return s;
+}
+
+static void print_string(word s)
+{
+  fwrite(string_chars(s), 1, string_length(s), stdout);
+}
+
+static word class_name(word o) { return class_nameTab[obj(o)[TAG]]; }
+
+/* Reads a line without its newline; the caller frees it */
+static char *read_line(size_t *n)
+{
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, stdin);
+  if (len < 0)
+    len = 0;
+  if (len > 0 && line[len - 1] == '\n')
+    line[--len] = '\0';
+  *n = len;
+  return line;
+}
+
+/*
+ * The routines called from Cool code.  They take their arguments and
+ * leave their results in the rt_ registers.
+ */
+
+void rt_object_copy(void) { rt_a0 = copy(rt_a0); }
+
+void rt_object_abort(void)
+{
+  printf("Abort called from class ");
+  print_string(class_name(rt_a0));
+  printf("\n");
+  cool_exit(0);
+}
+
+void rt_object_type_name(void) { rt_a0 = class_name(rt_a0); }
+
+void rt_io_out_string(void)
+{
+  print_string(arg(1));
+  pop(1);
+}
+
+void rt_io_out_int(void)
+{
+  printf("%d", (int32_t) obj(arg(1))[FIRST]);
+  pop(1);
+}
+
+void rt_io_in_string(void)
+{
+  size_t n;
+  char *line = read_line(&n);
+  rt_a0 = new_string(line ? line : "", n);
+  free(line);
+}
+
+void rt_io_in_int(void)
+{
+  size_t n;
+  char *line = read_line(&n), *end;
+  long long v = 0;
+  if (line)
+    {
+      char *start = line + strspn(line, " \t\r");
+      v = strtoll(start, &end, 10);
+      if (end == start || (*end && !strchr(" \t\r", *end)))
+	v = 0;
+    }
+  free(line);
+  rt_a0 = new_int((int32_t) v);
+}
+
+void rt_string_length(void) { rt_a0 = obj(rt_a0)[FIRST]; }
+
+void rt_string_concat(void)
+{
+  word a = rt_a0, b = arg(1);
+  word la = string_length(a), lb = string_length(b);
+  char *chars = malloc(la + lb + 1);
+  memcpy(chars, string_chars(a), la);
+  memcpy(chars + la, string_chars(b), lb);
+  rt_a0 = new_string(chars, la + lb);
+  free(chars);
+  pop(1);
+}
+
+void rt_string_substr(void)
+{
+  int32_t i = obj(arg(2))[FIRST], l = obj(arg(1))[FIRST];
+  int32_t n = string_length(rt_a0);
+  if (i < 0 || l < 0 || (int64_t) i + l > n)
+    {
+      printf("Index to substr is out of range\n");
+      cool_exit(1);
+    }
+  rt_a0 = new_string(string_chars(rt_a0) + i, l);
+  pop(2);
+}
+
+/* $t1 and $t2 are the objects; $a0 is left alone when they are equal */
+void rt_equality_test(void)
+{
+  word a = rt_t1, b = rt_t2;
+  int equal = a == b;
+  if (!equal && a && b && obj(a)[TAG] == obj(b)[TAG])
+    {
+      word tag = obj(a)[TAG];
+      if (tag == _int_tag || tag == _bool_tag)
+	equal = obj(a)[FIRST] == obj(b)[FIRST];
+      else if (tag == _string_tag)
+	equal = string_length(a) == string_length(b) &&
+	  memcmp(string_chars(a), string_chars(b), string_length(a)) == 0;
+    }
+  if (!equal)
+    rt_a0 = rt_a1;
+}
+
+void rt_dispatch_abort(void)
+{
+  print_string(rt_a0);
+  printf(":%d: Dispatch to void.\n", (int32_t) rt_t1);
+  cool_exit(1);
+}
+
+void rt_case_abort(void)
+{
+  printf("No match in case statement for Class ");
+  print_string(class_name(rt_a0));
+  printf("\n");
+  cool_exit(1);
+}
+
+void rt_case_abort2(void)
+{
+  print_string(rt_a0);
+  printf(":%d: Match on void in case statement.\n", (int32_t) rt_t1);
+  cool_exit(1);
+}
+
+void rt_nothing(void) { }
+
+/*
+ * Stubs and glue in assembly.  A stub puts its C function in %r8 and
+ * enters cool_runtime_call with the return address in cool_reg_ra.
+ * %r9-%r11 hold $s1-$s3, which C does not preserve.  %esp is the Cool
+ * stack pointer; the C function runs below it, on the Cool stack.
+ *
+ * cool_call(code, self, stack) runs Cool code from C: it switches to
+ * the Cool stack and returns $a0 when the code jumps to $ra.
+ */
+#define STUB(name, fn) \
+  "\t.globl\t" name "\n" name ":\n\tmovq\t$" fn ", %r8\n\tjmp\tcool_runtime_call\n"
+
+__asm__(
+  "\t.text\n"
+  STUB("Object.copy", "rt_object_copy")
+  STUB("Object.abort", "rt_object_abort")
+  STUB("Object.type_name", "rt_object_type_name")
+  STUB("IO.out_string", "rt_io_out_string")
+  STUB("IO.out_int", "rt_io_out_int")
+  STUB("IO.in_string", "rt_io_in_string")
+  STUB("IO.in_int", "rt_io_in_int")
+  STUB("String.length", "rt_string_length")
+  STUB("String.concat", "rt_string_concat")
+  STUB("String.substr", "rt_string_substr")
+  STUB("equality_test", "rt_equality_test")
+  STUB("_dispatch_abort", "rt_dispatch_abort")
+  STUB("_case_abort", "rt_case_abort")
+  STUB("_case_abort2", "rt_case_abort2")
+  STUB("_gc_check", "rt_nothing")
+  STUB("_GenGC_Assign", "rt_nothing")
+  STUB("_NoGC_Init", "rt_nothing")
+  STUB("_NoGC_Collect", "rt_nothing")
+  "cool_runtime_call:\n"
+  "\tmovl\t%eax, rt_a0\n"
+  "\tmovl\t%ecx, rt_a1\n"
+  "\tmovl\t%edx, rt_t1\n"
+  "\tmovl\t%esi, rt_t2\n"
+  "\tmovl\t%esp, rt_sp\n"
+  "\tpushq\t%r9\n"
+  "\tpushq\t%r10\n"
+  "\tpushq\t%r11\n"
+  "\tmovq\t%rsp, %r15\n"
+  "\tandq\t$-16, %rsp\n"
+  "\tcall\t*%r8\n"
+  "\tmovq\t%r15, %rsp\n"
+  "\tpopq\t%r11\n"
+  "\tpopq\t%r10\n"
+  "\tpopq\t%r9\n"
+  "\tmovl\trt_a0, %eax\n"
+  "\tmovl\trt_sp, %esp\n"
+  "\tjmp\t*cool_reg_ra\n"
+  "cool_call:\n"
+  "\tpushq\t%rbx\n"
+  "\tpushq\t%rbp\n"
+  "\tpushq\t%r12\n"
+  "\tpushq\t%r13\n"
+  "\tpushq\t%r14\n"
+  "\tpushq\t%r15\n"
+  "\tmovq\t%rsp, c_stack\n"
+  "\tmovl\t%edx, %esp\n"
+  "\tmovl\t%esi, %eax\n"
+  "\tmovq\t$cool_return, cool_reg_ra\n"
+  "\tjmp\t*%rdi\n"
+  "cool_return:\n"
+  "\tmovq\tc_stack, %rsp\n"
+  "\tpopq\t%r15\n"
+  "\tpopq\t%r14\n"
+  "\tpopq\t%r13\n"
+  "\tpopq\t%r12\n"
+  "\tpopq\t%rbp\n"
+  "\tpopq\t%rbx\n"
+  "\tret\n");
+
+uint64_t c_stack;
+word cool_call(char *code, word self, word stack);
+
+static void division_by_zero(int sig)
+{
+  (void) sig;
+  printf("Exception: division by zero\n");
+  cool_exit(1);
+}
+
+static char *map_low(size_t size)
+{
+  char *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(1);
+    }
+  return p;
+}
+
+int main(void)
+{
+  heap = map_low(HEAP_SIZE);
+  word stack = addr(map_low(STACK_SIZE) + STACK_SIZE - 16);
+  signal(SIGFPE, division_by_zero);
+
+  word self = cool_call(Main_init, copy(addr(Main_protObj)), stack);
+  cool_call(Main_main, self, stack);
+  printf("COOL program successfully executed\n");
+  cool_exit(0);
+  return 0;
+}
@@ -0,0 +1,309 @@
+//////////////////////////////////////////////////////////////////////
+//
+// x86.cc
+//
+// The x86-64 backend (-n).  The code generator always produces MIPS
+// assembly; with -n its output goes through X86Lowering, which turns
+// every line into the equivalent x86-64 GNU assembly for Linux.  The
+// objects, tables and calling convention are those of the MIPS code:
+// 4-byte words, the Cool stack addressed through $sp/$fp, and the
+// return address in $ra.  Since words hold pointers, the runtime keeps
+// the heap and the Cool stack in the low 2GB (MAP_32BIT), and programs
+// are linked without PIE so that code and data are there too:
+//
+//    gcc -no-pie prog.s x86-runtime.c -o prog
+//
+// MIPS registers map to x86 registers where there are enough of them;
+// the others live in memory, in the cool_reg_ words of the runtime.
+// %r8d and %r15d are scratch registers of the translation.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include "cgen.h"
+
+static const char *register_map[][2] = {
+  { "$a0", "%eax"  }, { "$a1", "%ecx"  }, { "$t1", "%edx"  }, { "$t2", "%esi"  },
+  { "$t3", "%edi"  }, { "$s0", "%ebx"  }, { "$fp", "%ebp"  }, { "$sp", "%esp"  },
+  { "$s1", "%r9d"  }, { "$s2", "%r10d" }, { "$s3", "%r11d" }, { "$s4", "%r12d" },
+  { "$s5", "%r13d" }, { "$s6", "%r14d" }, { NULL, NULL }
+};
+
+#define SCRATCH  "%r8d"
+#define SCRATCH2 "%r15d"
+
+static bool is_register(const std::string& op) { return op[0] == '%'; }
+static bool is_memory(const std::string& op) { return op[0] != '%' && op[0] != '$'; }
+
+//
+// The x86 operand standing for a MIPS operand: a register, the memory
+// word of a register without one, or an immediate.
+//
+static std::string operand(const std::string& mips)
+{
+  if (mips == ZERO)
+    return "$0";
+  if (mips[0] != '$')
+    return "$" + mips;
+  for (int i = 0; register_map[i][0]; i++)
+    if (mips == register_map[i][0])
+      return register_map[i][1];
+  return "cool_reg_" + mips.substr(1);
+}
+
+// The 64-bit name of a register, for indirect jumps
+static std::string reg64(const std::string& r)
+{
+  if (r[2] >= '0' && r[2] <= '9')             // %r8d ... %r15d
+    return r.substr(0, r.size() - 1);
+  return "%r" + r.substr(2);
+}
+
+static void emit(ostream& s, const std::string& op, const std::string& a)
+{ s << "\t" << op << "\t" << a << endl; }
+
+static void emit(ostream& s, const std::string& op, const std::string& a, const std::string& b)
+{ s << "\t" << op << "\t" << a << ", " << b << endl; }
+
+//
+// A register holding the value of a MIPS operand: its own one, or the
+// scratch register after loading it there.
+//
+static std::string in_register(const std::string& mips, const char *scratch, ostream& s)
+{
+  std::string op = operand(mips);
+  if (is_register(op))
+    return op;
+  emit(s, "movl", op, scratch);
+  return scratch;
+}
+
+static void assign(const std::string& dest, const std::string& value, ostream& s)
+{
+  if (dest == value)
+    return;
+  if (is_memory(dest) && is_memory(value))
+    {
+      emit(s, "movl", value, SCRATCH);
+      emit(s, "movl", SCRATCH, dest);
+    }
+  else
+    emit(s, "movl", value, dest);
+}
+
+// Translates "off(reg)" into an x86 memory operand
+static std::string address(const std::string& mips, ostream& s)
+{
+  std::string::size_type open = mips.find('(');
+  std::string base = mips.substr(open + 1, mips.size() - open - 2);
+  return mips.substr(0, open) + "(" + in_register(base, SCRATCH, s) + ")";
+}
+
+// dest = a op b, for the two-operand x86 instructions
+static void arith(const char *op, const Instr& in, ostream& s)
+{
+  emit(s, "movl", operand(in.args[1]), SCRATCH);
+  emit(s, op, operand(in.args[2]), SCRATCH);
+  emit(s, "movl", SCRATCH, operand(in.args[0]));
+}
+
+//
+// idivl divides %edx:%eax, which hold $t1 and $a0, so both are kept in
+// the scratch registers around it.  INT_MIN / -1 overflows on x86 but
+// not on MIPS, hence the test for -1.
+//
+static void divide(const Instr& in, ostream& s)
+{
+  std::string dest = operand(in.args[0]);
+  std::string a = operand(in.args[1]);
+  std::string b = operand(in.args[2]);
+
+  emit(s, "movl", "%eax", SCRATCH);
+  emit(s, "movl", "%edx", SCRATCH2);
+  if (a == "%edx")
+    emit(s, "movl", SCRATCH2, "%eax");
+  else if (a != "%eax")
+    emit(s, "movl", a, "%eax");
+  if (b == "%eax")
+    b = SCRATCH;
+  else if (b == "%edx")
+    b = SCRATCH2;
+
+  emit(s, "cmpl", "$-1", b);
+  emit(s, "jne", "1f");
+  emit(s, "negl", "%eax");
+  emit(s, "jmp", "2f");
+  s << "1:" << endl;
+  s << "\tcltd" << endl;
+  emit(s, "idivl", b);
+  s << "2:" << endl;
+
+  if (dest == "%eax")
+    emit(s, "movl", SCRATCH2, "%edx");
+  else if (dest == "%edx")
+    {
+      emit(s, "movl", "%eax", "%edx");
+      emit(s, "movl", SCRATCH, "%eax");
+    }
+  else
+    {
+      emit(s, "movl", "%eax", dest);
+      emit(s, "movl", SCRATCH, "%eax");
+      emit(s, "movl", SCRATCH2, "%edx");
+    }
+}
+
+static void branch(const char *jump, const Instr& in, ostream& s)
+{
+  std::string a = operand(in.args[0]);
+  std::string b = in.args.size() == 3 ? operand(in.args[1]) : "$0";
+  if (!is_register(a) && (is_memory(b) || a[0] == '$'))
+    a = in_register(in.args[0], SCRATCH, s);
+  emit(s, "cmpl", b, a);
+  emit(s, jump, in.args.back());
+}
+
+// Calls leave the return address in $ra, like jal and jalr
+static void call(const std::string& target, ostream& s)
+{
+  emit(s, "movl", "$1f", "cool_reg_ra");
+  emit(s, "jmp", target);
+  s << "1:" << endl;
+}
+
+static void lower(const Instr& in, ostream& s)
+{
+  const std::string& op = in.op;
+
+  if (op == ".word")
+    emit(s, ".long", in.args[0]);
+  else if (op == ".align")
+    emit(s, ".balign", "4");
+  else if (op[0] == '.')
+    {
+      s << "\t" << op;
+      for (unsigned i = 0; i < in.args.size(); i++)
+	s << "\t" << in.args[i];
+      s << endl;
+    }
+  else if (op == "lw")
+    {
+      std::string from = address(in.args[1], s);
+      std::string dest = operand(in.args[0]);
+      if (is_register(dest))
+	emit(s, "movl", from, dest);
+      else
+	{
+	  emit(s, "movl", from, SCRATCH2);
+	  emit(s, "movl", SCRATCH2, dest);
+	}
+    }
+  else if (op == "sw")
+    {
+      std::string to = address(in.args[1], s);
+      std::string value = operand(in.args[0]);
+      if (is_memory(value))
+	{
+	  emit(s, "movl", value, SCRATCH2);
+	  value = SCRATCH2;
+	}
+      emit(s, "movl", value, to);
+    }
+  else if (op == "li" || op == "la")
+    emit(s, "movl", "$" + in.args[1], operand(in.args[0]));
+  else if (op == "move")
+    assign(operand(in.args[0]), operand(in.args[1]), s);
+  else if (op == "neg")
+    {
+      emit(s, "movl", operand(in.args[1]), SCRATCH);
+      emit(s, "negl", SCRATCH);
+      emit(s, "movl", SCRATCH, operand(in.args[0]));
+    }
+  else if (op == "add" || op == "addu" || op == "addi" || op == "addiu")
+    arith("addl", in, s);
+  else if (op == "sub" || op == "subu")
+    arith("subl", in, s);
+  else if (op == "mul")
+    arith("imull", in, s);
+  else if (op == "and")
+    arith("andl", in, s);
+  else if (op == "or")
+    arith("orl", in, s);
+  else if (op == "xor")
+    arith("xorl", in, s);
+  else if (op == "sll")
+    arith("shll", in, s);
+  else if (op == "srl")
+    arith("shrl", in, s);
+  else if (op == "sra")
+    arith("sarl", in, s);
+  else if (op == "div")
+    divide(in, s);
+  else if (op == "b" || op == "j")
+    emit(s, "jmp", in.args[0]);
+  else if (op == "beq" || op == "beqz")
+    branch("je", in, s);
+  else if (op == "bne" || op == "bnez")
+    branch("jne", in, s);
+  else if (op == "blt")
+    branch("jl", in, s);
+  else if (op == "ble")
+    branch("jle", in, s);
+  else if (op == "bgt")
+    branch("jg", in, s);
+  else if (op == "bge")
+    branch("jge", in, s);
+  else if (op == "jal")
+    call(in.args[0], s);
+  else if (op == "jalr")
+    call("*" + reg64(in_register(in.args[0], SCRATCH, s)), s);
+  else if (op == "jr")
+    {
+      if (in.args[0] == RA)
+	emit(s, "jmp", "*cool_reg_ra");
+      else
+	emit(s, "jmp", "*" + reg64(in_register(in.args[0], SCRATCH, s)));
+    }
+  else
+    {
+      cerr << "x86 backend: cannot translate " << op << endl;
+      exit(1);
+    }
+}
+
+int X86Lowering::overflow(int c)
+{
+  if (c == EOF)
+    return 0;
+  if (c == '\n')
+    lower_line();
+  else
+    line += (char) c;
+  return c;
+}
+
+void X86Lowering::lower_line()
+{
+  std::string::size_type first = line.find_first_not_of(" \t");
+  Instr in;
+
+  // The Cool code does not need an executable stack
+  if (!started)
+    {
+      out << "\t.section\t.note.GNU-stack,\"\",@progbits" << endl;
+      started = TRUE;
+    }
+
+  // Comments and strings are the same in both assemblers
+  if (first != std::string::npos &&
+      (line[first] == '#' || line.compare(first, 6, ".ascii") == 0))
+    out << line << endl;
+  else if (parse_instr(line, in))
+    {
+      if (!in.label.empty())
+	out << in.label << ":" << endl;
+      else
+	lower(in, out);
+    }
+  line.clear();
+}